@@ -0,0 +1,211 @@
+#include "batch.h"
+#include <core.h>
+#include <gui/gui.h>
+#include <signal_path/signal_path.h>
+#include <utils/iq_file.h>
+#include <utils/flog.h>
+#include <dsp/buffer/buffer.h>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <stdio.h>
+
+namespace batch {
+    dsp::stream<dsp::complex_t> input;
+    float* fftBuf = NULL;
+
+    float* _fftAcquire(void* ctx) {
+        return fftBuf;
+    }
+
+    void _fftRelease(void* ctx) {}
+
+    std::string num(double value, int decimals) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+        return buf;
+    }
+
+    void setInputSampleRate(double samplerate) {
+        flog::warn("Ignoring samplerate change to {0} in batch mode", samplerate);
+    }
+
+    bool loadModule(std::string name, std::string modulesDir, const std::vector<std::string>& extraModules) {
+        // Look in the modules directory first, then in the additional modules of the config
+        std::filesystem::path path = std::filesystem::path(modulesDir) / (name + SDRPP_MOD_EXTENTSION);
+        if (!std::filesystem::is_regular_file(path)) {
+            for (const auto& apath : extraModules) {
+                std::filesystem::path file = std::filesystem::absolute(apath);
+                if (file.stem().string() == name && std::filesystem::is_regular_file(file)) {
+                    path = file;
+                    break;
+                }
+            }
+        }
+        if (!std::filesystem::is_regular_file(path)) {
+            flog::error("Could not find module {0}", name);
+            return false;
+        }
+        flog::info("Loading {0}", path.generic_string());
+        core::moduleManager.loadModule(path.generic_string());
+        return true;
+    }
+
+    int main() {
+        flog::info("=====| BATCH MODE |=====");
+
+        // Load the job
+        std::string jobPath = core::args["batch"].s();
+        json job;
+        try {
+            std::ifstream file(jobPath);
+            file >> job;
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not load batch job {0}: {1}", jobPath, e.what());
+            return -1;
+        }
+        if (!job.contains("input") || !job["input"].contains("path")) {
+            flog::error("The batch job has no input path");
+            return -1;
+        }
+
+        // Parse the shard
+        int shard = 0;
+        int shardCount = 1;
+        std::string shardStr = core::args["shard"].s();
+        if (sscanf(shardStr.c_str(), "%d/%d", &shard, &shardCount) != 2 || shardCount < 1 || shard < 0 || shard >= shardCount) {
+            flog::error("Invalid shard '{0}', expected index/count", shardStr);
+            return -1;
+        }
+
+        // Open the input, relative paths are relative to the job file
+        json in = job["input"];
+        std::filesystem::path inputPath = in["path"].get<std::string>();
+        if (inputPath.is_relative()) { inputPath = std::filesystem::absolute(jobPath).parent_path() / inputPath; }
+        std::map<std::string, SampleFormat> formats = {
+            { "cu8", SAMPLE_FORMAT_CU8 },
+            { "cs8", SAMPLE_FORMAT_CS8 },
+            { "cs16", SAMPLE_FORMAT_CS16 },
+            { "cf32", SAMPLE_FORMAT_CF32 }
+        };
+        std::string formatStr = in.value("format", "cs16");
+        if (formats.find(formatStr) == formats.end()) {
+            flog::error("Unknown input format '{0}'", formatStr);
+            return -1;
+        }
+        IQFile file;
+        try {
+            file.open(inputPath.string(), formats[formatStr], in.value("sampleRate", 0.0));
+        }
+        catch (const std::exception& e) {
+            flog::error("Could not open {0}: {1}", inputPath.string(), e.what());
+            return -1;
+        }
+        double sampleRate = file.getSampleRate();
+        double centerFreq = in.value("frequency", file.hasFrequency() ? file.getFrequency() : 0.0);
+
+        // Range of this shard, starting early to let the decoders lock on
+        uint64_t count = file.getSampleCount();
+        uint64_t begin = (count * shard) / shardCount;
+        uint64_t end = (count * (shard + 1)) / shardCount;
+        uint64_t overlap = job.value("overlap", 1.0) * sampleRate;
+        begin = (begin > overlap) ? (begin - overlap) : 0;
+        int blockSize = std::clamp<int>(job.value("blockSize", BATCH_BLOCK_SIZE), 1024, STREAM_BUFFER_SIZE);
+
+        // Init DSP, the spectrum isn't shown so it runs as slowly as possible
+        fftBuf = dsp::buffer::alloc<float>(BATCH_FFT_SIZE);
+        sigpath::iqFrontEnd.init(&input, sampleRate, false, 1, false, BATCH_FFT_SIZE, BATCH_FFT_RATE, IQFrontEnd::FFTWindow::NUTTALL, _fftAcquire, _fftRelease, NULL);
+        sigpath::iqFrontEnd.start();
+        gui::waterfall.setBandwidth(sampleRate);
+        gui::waterfall.setViewBandwidth(sampleRate);
+        gui::waterfall.setCenterFrequency(centerFreq);
+
+        // Load the modules of the job
+        core::configManager.acquire();
+        std::string modulesDir = core::configManager.conf["modulesDirectory"];
+        std::vector<std::string> extraModules = core::configManager.conf["modules"];
+        core::configManager.release();
+        modulesDir = std::filesystem::absolute(modulesDir).string();
+        for (const auto& name : job.value("modules", std::vector<std::string>())) {
+            if (!loadModule(name, modulesDir, extraModules)) { return -1; }
+        }
+
+        // Create instances
+        std::vector<std::string> instances;
+        for (auto const& [name, inst] : job.value("instances", json::object()).items()) {
+            std::string mod = inst["module"];
+            if (core::moduleManager.modules.find(mod) == core::moduleManager.modules.end()) {
+                flog::error("Module {0} of instance {1} isn't loaded", mod, name);
+                return -1;
+            }
+            flog::info("Initializing {0} ({1})", name, mod);
+            core::moduleManager.createInstance(name, mod);
+            instances.push_back(name);
+        }
+        core::moduleManager.doPostInitAll();
+
+        // Tune the VFOs
+        for (auto const& [name, vfo] : job.value("vfos", json::object()).items()) {
+            if (vfo.contains("frequency")) {
+                sigpath::vfoManager.setOffset(name, vfo["frequency"].get<double>() - centerFreq);
+            }
+            if (vfo.contains("bandwidth")) {
+                sigpath::vfoManager.setBandwidth(name, vfo["bandwidth"].get<double>());
+            }
+        }
+
+        flog::info("Processing samples {0} to {1} of {2} (shard {3}/{4})", begin, end, inputPath.string(), shard, shardCount);
+
+        // Feed the file, the stream blocks until the DSP has consumed the previous block so it runs as fast as the slowest module
+        std::vector<double> blockTimes;
+        blockTimes.reserve(((end - begin) / blockSize) + 1);
+        file.seek(begin);
+        uint64_t pos = begin;
+        auto start = std::chrono::steady_clock::now();
+        while (pos < end) {
+            int n = std::min<uint64_t>(blockSize, end - pos);
+            auto blockStart = std::chrono::steady_clock::now();
+            file.read(input.writeBuf, n);
+            if (!input.swap(n)) { break; }
+            blockTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - blockStart).count());
+            pos += n;
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Push the last blocks out of every stage of the graph with some silence
+        for (int i = 0; i < BATCH_FLUSH_BLOCKS && pos >= end; i++) {
+            dsp::buffer::clear(input.writeBuf, blockSize);
+            if (!input.swap(blockSize)) { break; }
+        }
+
+        // Shut down, deleting the instances makes the decoders close their outputs
+        for (const auto& name : instances) {
+            core::moduleManager.deleteInstance(name);
+        }
+        for (auto& [name, mod] : core::moduleManager.modules) {
+            mod.end();
+        }
+        sigpath::iqFrontEnd.stop();
+        dsp::buffer::free(fftBuf);
+
+        // Statistics
+        uint64_t processed = pos - begin;
+        std::sort(blockTimes.begin(), blockTimes.end());
+        double total = 0.0;
+        for (double t : blockTimes) { total += t; }
+        auto percentile = [&](double p) {
+            return blockTimes.empty() ? 0.0 : blockTimes[std::min<size_t>(blockTimes.size() * p, blockTimes.size() - 1)];
+        };
+        flog::info("Processed {0} samples ({1}s of signal) in {2}s", processed, num(processed / sampleRate, 1), num(elapsed, 2));
+        flog::info("Throughput: {0} MS/s, {1}x real-time", num(processed / elapsed / 1e6, 2), num((processed / sampleRate) / elapsed, 1));
+        flog::info("Input blocks: {0} of up to {1} samples, time to accept min {2}ms, mean {3}ms, median {4}ms, p99 {5}ms, max {6}ms", blockTimes.size(), blockSize,
+                   num(percentile(0.0), 3), num(blockTimes.empty() ? 0.0 : total / blockTimes.size(), 3), num(percentile(0.5), 3), num(percentile(0.99), 3), num(percentile(1.0), 3));
+
+        return (pos < end) ? -1 : 0;
+    }
+}
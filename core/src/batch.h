@@ -0,0 +1,47 @@
+#pragma once
+#include <dsp/stream.h>
+#include <dsp/types.h>
+
+// Size of the spectrum computed in batch mode, nothing displays it so it's kept as cheap as possible
+#define BATCH_FFT_SIZE      1024
+#define BATCH_FFT_RATE      1.0
+
+// Default number of samples fed to the DSP at once
+#define BATCH_BLOCK_SIZE    65536
+
+// Blocks of silence fed after the end of the input so that nothing is left in flight in the graph
+#define BATCH_FLUSH_BLOCKS  8
+
+namespace batch {
+    /**
+     * Runs the DSP graph without a GUI over an IQ file described by a job file, as fast as the modules can
+     * process it, then exits with throughput statistics. Example job:
+     *
+     *   {
+     *     "input": { "path": "capture.sigmf-meta", "frequency": 152000000 },
+     *     "modules": [ "radio", "pager_decoder" ],
+     *     "instances": {
+     *       "Radio": { "module": "radio" },
+     *       "Pager": { "module": "pager_decoder" }
+     *     },
+     *     "vfos": {
+     *       "Radio": { "frequency": 152840000, "bandwidth": 12500 },
+     *       "Pager": { "frequency": 152840000 }
+     *     }
+     *   }
+     *
+     * Raw files also need "format" (cu8, cs8, cs16 or cf32) and "sampleRate" in the input. Modules are
+     * configured through their usual config files in the root directory. Large files can be split over
+     * several processes with --shard index/count, each shard starting "overlap" seconds early (default 1)
+     * so that decoders are in sync when their part begins.
+     *
+     * The statistics are for the whole graph: aggregate throughput and real-time factor, plus the time each
+     * input block took to be accepted, which is how long the slowest stage held the pipeline back. They aren't
+     * broken down per DSP block since every block runs on its own thread and mostly waits on its streams, so
+     * timing them one by one would measure the waits rather than the work. Use sdrpp_dsp_bench for that.
+     */
+    int main();
+
+    // The sample rate is set by the input file, requests from modules are ignored
+    void setInputSampleRate(double samplerate);
+}
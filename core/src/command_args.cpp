@@ -14,11 +14,13 @@ void CommandArgsParser::defineAll() {
 #endif
 
         define('a', "addr", "Server mode address", "0.0.0.0");
+        define('b', "batch", "Process an IQ file without GUI, as described by the given job file", "");
         define('h', "help", "Show help");
         define('p', "port", "Server mode port", 5259);
         define('r', "root", "Root directory, where all config files are stored", std::filesystem::absolute(root).string());
         define('s', "server", "Run in server mode");
         define('\0', "autostart", "Automatically start the SDR after loading");
+        define('\0', "shard", "Part of the input processed in batch mode, as index/count", "0/1");
 }
 
 int CommandArgsParser::parse(int argc, char* argv[]) {
@@ -1,4 +1,5 @@
 #include <server.h>
+#include <batch.h>
 #include "imgui.h"
 #include <stdio.h>
 #include <gui/main_window.h>
@@ -41,6 +42,7 @@ namespace core {
     void setInputSampleRate(double samplerate) {
         // Forward this to the server
         if (args["server"].b()) { server::setInputSampleRate(samplerate); return; }
+        if (!args["batch"].s().empty()) { batch::setInputSampleRate(samplerate); return; }
         
         // Update IQ frontend input samplerate and get effective samplerate
         sigpath::iqFrontEnd.setSampleRate(samplerate);
@@ -78,10 +80,11 @@ int sdrpp_main(int argc, char* argv[]) {
     }
 
     bool serverMode = (bool)core::args["server"];
+    bool batchMode = !core::args["batch"].s().empty();
 
 #ifdef _WIN32
-    // Free console if the user hasn't asked for a console and not in server mode
-    if (!core::args["con"].b() && !serverMode) { FreeConsole(); }
+    // Free console if the user hasn't asked for a console and not in server or batch mode
+    if (!core::args["con"].b() && !serverMode && !batchMode) { FreeConsole(); }
 
     // Set error mode to avoid abnoxious popups
     SetErrorMode(SEM_NOOPENFILEERRORBOX | SEM_NOGPFAULTERRORBOX | SEM_FAILCRITICALERRORS);
@@ -122,6 +125,8 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["snrSmoothing"] = false;
     defConfig["snrSmoothingSpeed"] = 20;
     defConfig["fastFFT"] = false;
+    defConfig["fftAveraging"] = false;
+    defConfig["fftMeasuredPlans"] = false;
     defConfig["fftHeight"] = 300;
     defConfig["fftRate"] = 20;
     defConfig["fftSize"] = 65536;
@@ -247,6 +252,7 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["showWaterfall"] = true;
     defConfig["source"] = "";
     defConfig["decimation"] = 1;
+    defConfig["channelizer"] = 0;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
 
@@ -354,9 +360,20 @@ int sdrpp_main(int argc, char* argv[]) {
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    bool fftMeasuredPlans = core::configManager.conf["fftMeasuredPlans"];
+    int fftSize = core::configManager.conf["fftSize"];
+
     core::configManager.release(true);
 
+    // Load the FFT wisdom of previous runs and measure the spectrum FFT in the background if enabled
+    if (!dsp::fft::planCache.loadWisdom(root + "/fftw_wisdom")) {
+        flog::info("No FFT wisdom loaded, plans will be created from scratch");
+    }
+    dsp::fft::planCache.setMode(fftMeasuredPlans ? dsp::fft::PLAN_MODE_MEASURE : dsp::fft::PLAN_MODE_ESTIMATE);
+    dsp::fft::planCache.warmup({ fftSize });
+
     if (serverMode) { return server::main(); }
+    if (batchMode) { return batch::main(); }
 
     core::configManager.acquire();
     std::string resDir = core::configManager.conf["resourcesDirectory"];
@@ -414,6 +431,7 @@ int sdrpp_main(int argc, char* argv[]) {
 
     core::configManager.disableAutoSave();
     core::configManager.save();
+    dsp::fft::planCache.saveWisdom();
 #endif
 
     flog::info("Exiting successfully");
@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../buffer/buffer.h"
+#include "../types.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define DSP_BENCH_HAS_TSC
+#endif
+
+// Number of untimed runs done before measuring, lets lazily sized buffers reach their final size
+#define DSP_BENCH_WARMUP_RUNS 8
+
+namespace dsp::bench {
+    // Incremented by whoever hooks the allocator, the benchmark tool does it by replacing operator new
+    inline std::atomic<uint64_t> allocCount = 0;
+
+    struct Result {
+        int64_t samples = 0;
+        double seconds = 0.0;
+        double msps = 0.0;
+        double nsPerSample = 0.0;
+        double cyclesPerSample = -1.0; // Negative if the CPU has no usable cycle counter
+        uint64_t allocations = 0;
+    };
+
+    inline uint64_t readCycles() {
+#ifdef DSP_BENCH_HAS_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    template <class T>
+    inline void randomFill(T* buffer, int count) {
+        float* fbuf = (float*)buffer;
+        int fcount = count * (sizeof(T) / sizeof(float));
+        for (int i = 0; i < fcount; i++) {
+            fbuf[i] = (2.0f * (float)rand() / (float)RAND_MAX) - 1.0f;
+        }
+    }
+
+    /**
+     * Call process(count, in, out) back to back on random input for at least durationMs milliseconds, without
+     * any stream or thread in between, and measure the cost per input sample. outSize must be large enough
+     * for the output of a single call.
+     */
+    template <class I, class O, class Func>
+    inline Result benchmarkProcess(Func process, int bufferSize, int outSize, int durationMs) {
+        I* in = buffer::alloc<I>(bufferSize);
+        O* out = buffer::alloc<O>(outSize);
+        randomFill(in, bufferSize);
+
+        for (int i = 0; i < DSP_BENCH_WARMUP_RUNS; i++) {
+            process(bufferSize, in, out);
+        }
+
+        // Measure, only checking the clock between calls
+        Result res;
+        uint64_t allocStart = allocCount.load();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start + std::chrono::milliseconds(durationMs);
+        auto now = start;
+        uint64_t cycleStart = readCycles();
+        do {
+            process(bufferSize, in, out);
+            res.samples += bufferSize;
+            now = std::chrono::high_resolution_clock::now();
+        } while (now < end);
+        uint64_t cycleEnd = readCycles();
+        res.allocations = allocCount.load() - allocStart;
+
+        res.seconds = std::chrono::duration<double>(now - start).count();
+        res.msps = (double)res.samples / res.seconds / 1e6;
+        res.nsPerSample = res.seconds * 1e9 / (double)res.samples;
+#ifdef DSP_BENCH_HAS_TSC
+        res.cyclesPerSample = (double)(cycleEnd - cycleStart) / (double)res.samples;
+#endif
+
+        buffer::free(in);
+        buffer::free(out);
+        return res;
+    }
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <algorithm>
 #include "stream.h"
+#include "scheduler.h"
 #include "types.h"
 
 namespace dsp {
@@ -13,6 +14,7 @@ namespace dsp {
         virtual void start() {}
         virtual void stop() {}
         virtual int run() { return -1; }
+        virtual void setScheduler(sched::Pool* pool) {}
     };
 
     class block : public generic_block {
@@ -63,12 +65,56 @@ namespace dsp {
 
         virtual int run() = 0;
 
+        /**
+         * Run the block as tasks on a shared worker pool instead of its own thread. run() is then only
+         * called once all inputs have data and all outputs can be swapped, so it must not wait on
+         * anything else. Blocks without inputs always use their own thread. Pass NULL to go back to
+         * a dedicated thread.
+         */
+        virtual void setScheduler(sched::Pool* pool) {
+            assert(_block_init);
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            tempStop();
+            _pool = pool;
+            tempStart();
+        }
+
     protected:
+        class BlockTask : public sched::Task {
+        public:
+            BlockTask(block* blk) : _blk(blk) {}
+
+            bool ready() {
+                for (auto& in : _blk->inputs) {
+                    if (!in->isReadable()) { return false; }
+                }
+                for (auto& out : _blk->outputs) {
+                    if (!out->isWritable()) { return false; }
+                }
+                return true;
+            }
+
+            bool step() {
+                return _blk->run() >= 0;
+            }
+
+        private:
+            block* _blk;
+        };
+
         void workerLoop() {
             while (run() >= 0) {}
         }
 
         virtual void doStart() {
+            // Use the pool if one was given
+            if (_pool && !inputs.empty()) {
+                for (auto& in : inputs) { in->setReaderObserver(&task); }
+                for (auto& out : outputs) { out->setWriterObserver(&task); }
+                task.enable(_pool);
+                scheduled = true;
+                return;
+            }
             workerThread = std::thread(&block::workerLoop, this);
         }
 
@@ -80,6 +126,14 @@ namespace dsp {
                 out->stopWriter();
             }
 
+            // Detach from the streams before waiting for the task so that nothing can reschedule it
+            if (scheduled) {
+                for (auto& in : inputs) { in->setReaderObserver(NULL); }
+                for (auto& out : outputs) { out->setWriterObserver(NULL); }
+                task.disable();
+                scheduled = false;
+            }
+
             // TODO: Make sure this isn't needed, I don't know why it stops
             if (workerThread.joinable()) {
                 workerThread.join();
@@ -128,5 +182,9 @@ namespace dsp {
         bool tempStopped = false;
         int tempStopDepth = 0;
         std::thread workerThread;
+
+        sched::Pool* _pool = NULL;
+        BlockTask task = BlockTask(this);
+        bool scheduled = false;
     };
 }
\ No newline at end of file
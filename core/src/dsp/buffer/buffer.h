@@ -1,6 +1,7 @@
 #pragma once
 #include <volk/volk.h>
 #include <string.h>
+#include <algorithm>
 
 namespace dsp::buffer {
     template<class T>
@@ -16,4 +17,19 @@ namespace dsp::buffer {
     inline void free(void* buffer) {
         volk_free(buffer);
     }
+
+    // Grow a buffer to hold at least count elements, keeping its first keep elements. Returns true if it was reallocated.
+    template<class T>
+    inline bool grow(T*& buffer, int& size, int count, int keep = 0) {
+        if (count <= size) { return false; }
+        int newSize = std::max<int>(count, size + (size / 2));
+        T* newBuffer = alloc<T>(newSize);
+        if (buffer) {
+            if (keep) { memcpy(newBuffer, buffer, keep * sizeof(T)); }
+            free(buffer);
+        }
+        buffer = newBuffer;
+        size = newSize;
+        return true;
+    }
 }
\ No newline at end of file
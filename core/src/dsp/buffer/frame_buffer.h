@@ -24,9 +24,12 @@ namespace dsp::buffer {
         void init(stream<T>* in) {
             _in = in;
 
+            // The frame buffers grow to fit the blocks they get, the output starts at the size of the input
             for (int i = 0; i < TEST_BUFFER_SIZE; i++) {
-                buffers[i] = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+                buffers[i] = NULL;
+                bufferSizes[i] = 0;
             }
+            out.setBufferSize(_in->getBufferSize());
 
             base_type::registerInput(in);
             base_type::registerOutput(&out);
@@ -48,12 +51,27 @@ namespace dsp::buffer {
             readCur = writeCur;
         }
 
+        void setBypass(bool enabled) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            bypass = enabled;
+
+            // Drop the queued frames so that the worker and the bypass path never write to the output at the same time
+            flush();
+            base_type::tempStart();
+        }
+
         int run() {
             // Wait for data
             int count = _in->read();
             if (count < 0) { return -1; }
 
             if (bypass) {
+                if (!out.reserve(count)) {
+                    _in->flush();
+                    return -1;
+                }
                 memcpy(out.writeBuf, _in->readBuf, count * sizeof(T));
                 _in->flush();
                 if (!out.swap(count)) { return -1; }
@@ -63,6 +81,7 @@ namespace dsp::buffer {
             // Push it on the ring buffer
             {
                 std::lock_guard<std::mutex> lck(bufMtx);
+                buffer::grow(buffers[writeCur], bufferSizes[writeCur], count);
                 memcpy(buffers[writeCur], _in->readBuf, count * sizeof(T));
                 sizes[writeCur] = count;
                 writeCur++;
@@ -82,6 +101,7 @@ namespace dsp::buffer {
 
                 // Write one to output buffer and unlock in preparation to swap buffers
                 int count = sizes[readCur];
+                if (!out.reserve(count)) { break; }
                 memcpy(out.writeBuf, buffers[readCur], count * sizeof(T));
                 readCur++;
                 readCur = ((readCur) % TEST_BUFFER_SIZE);
@@ -108,7 +128,10 @@ namespace dsp::buffer {
         void doStop() {
             _in->stopReader();
             out.stopWriter();
-            stopWorker = true;
+            {
+                std::lock_guard<std::mutex> lck(bufMtx);
+                stopWorker = true;
+            }
             cnd.notify_all();
 
             if (base_type::workerThread.joinable()) { base_type::workerThread.join(); }
@@ -125,6 +148,7 @@ namespace dsp::buffer {
         std::mutex bufMtx;
         std::condition_variable cnd;
         T* buffers[TEST_BUFFER_SIZE];
+        int bufferSizes[TEST_BUFFER_SIZE];
         int sizes[TEST_BUFFER_SIZE];
 
         bool stopWorker = false;
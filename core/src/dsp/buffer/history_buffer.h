@@ -0,0 +1,142 @@
+#pragma once
+#include "buffer.h"
+#include <atomic>
+#include <stdexcept>
+#include <stdint.h>
+#include <assert.h>
+
+namespace dsp::buffer {
+    /**
+     * Keeps the most recent samples of a stream, overwriting the oldest ones. Unlike RingBuffer, the writer never
+     * waits: it's meant to be fed from a DSP thread while another thread copies out a past range of samples.
+     * Samples are frames of one or more float channels (1 for mono, 2 for complex or stereo) addressed by their
+     * absolute index since the buffer was initialized. In compact mode they are stored as int16 which halves the
+     * memory, values are then clipped to [-1.0, 1.0].
+     *
+     * There is a single writer and a single reader. Neither takes a lock: the reader checks after copying that
+     * the writer didn't overwrite what it was reading, and drops those samples if it did.
+     */
+    class HistoryBuffer {
+    public:
+        HistoryBuffer() {}
+
+        HistoryBuffer(int channels, uint64_t frames, bool compact = false) { init(channels, frames, compact); }
+
+        ~HistoryBuffer() {
+            if (!_init) { return; }
+            buffer::free(_buffer);
+            _init = false;
+        }
+
+        void init(int channels, uint64_t frames, bool compact = false) {
+            assert(!_init);
+            assert(channels > 0 && frames > 0);
+            _channels = channels;
+            _capacity = frames;
+            _compact = compact;
+            _written = 0;
+            _writing = 0;
+            _buffer = volk_malloc(_capacity * _channels * (_compact ? sizeof(int16_t) : sizeof(float)), volk_get_alignment());
+            if (!_buffer) { throw std::runtime_error("[HistoryBuffer] Could not allocate the buffer"); }
+            _init = true;
+        }
+
+        bool isInit() { return _init; }
+
+        // Number of frames kept
+        uint64_t getCapacity() { return _capacity; }
+
+        int getChannels() { return _channels; }
+
+        // Index of the next frame to be written, that is the number of frames written so far
+        uint64_t getWritten() { return _written.load(std::memory_order_acquire); }
+
+        // Index of the oldest frame still in the buffer
+        uint64_t getOldest() {
+            uint64_t w = getWritten();
+            return (w > _capacity) ? (w - _capacity) : 0;
+        }
+
+        void write(const float* data, int count) {
+            assert(_init);
+            if (count <= 0) { return; }
+
+            // Only the last frames of a write larger than the buffer would survive it
+            uint64_t w = _written.load(std::memory_order_relaxed);
+            if ((uint64_t)count > _capacity) {
+                data += (count - _capacity) * _channels;
+                w += count - _capacity;
+                count = _capacity;
+            }
+
+            // Announce the range being overwritten before touching it
+            _writing.store(w + count, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            uint64_t pos = w % _capacity;
+            uint64_t first = std::min<uint64_t>(count, _capacity - pos);
+            store(pos, data, first);
+            if (first < (uint64_t)count) { store(0, &data[first * _channels], count - first); }
+
+            _written.store(w + count, std::memory_order_release);
+        }
+
+        /**
+         * Copies up to count frames starting at frame from. If some of them were already overwritten, from is
+         * moved forward to the oldest frame that was still valid. Returns the number of frames copied, which
+         * is less than count if the writer hasn't got that far yet.
+         */
+        int read(uint64_t& from, float* data, int count) {
+            assert(_init);
+            uint64_t w = getWritten();
+            uint64_t oldest = (w > _capacity) ? (w - _capacity) : 0;
+            if (from < oldest) { from = oldest; }
+            if (from >= w) { return 0; }
+            count = std::min<uint64_t>(count, w - from);
+
+            uint64_t pos = from % _capacity;
+            uint64_t first = std::min<uint64_t>(count, _capacity - pos);
+            load(pos, data, first);
+            if (first < (uint64_t)count) { load(0, &data[first * _channels], count - first); }
+
+            // Drop whatever the writer started overwriting while it was being copied
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t writing = _writing.load(std::memory_order_relaxed);
+            uint64_t valid = (writing > _capacity) ? (writing - _capacity) : 0;
+            if (valid > from) {
+                uint64_t lost = std::min<uint64_t>(valid - from, count);
+                count -= lost;
+                from += lost;
+                if (count) { memmove(data, &data[lost * _channels], count * _channels * sizeof(float)); }
+            }
+            return count;
+        }
+
+    private:
+        void store(uint64_t pos, const float* data, uint64_t count) {
+            if (_compact) {
+                volk_32f_s32f_convert_16i(&((int16_t*)_buffer)[pos * _channels], data, 32767.0f, count * _channels);
+            }
+            else {
+                memcpy(&((float*)_buffer)[pos * _channels], data, count * _channels * sizeof(float));
+            }
+        }
+
+        void load(uint64_t pos, float* data, uint64_t count) {
+            if (_compact) {
+                volk_16i_s32f_convert_32f(data, &((int16_t*)_buffer)[pos * _channels], 32767.0f, count * _channels);
+            }
+            else {
+                memcpy(data, &((float*)_buffer)[pos * _channels], count * _channels * sizeof(float));
+            }
+        }
+
+        bool _init = false;
+        void* _buffer;
+        int _channels;
+        uint64_t _capacity;
+        bool _compact;
+        std::atomic<uint64_t> _written;
+        std::atomic<uint64_t> _writing;
+    };
+}
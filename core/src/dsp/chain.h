@@ -4,6 +4,69 @@
 #include "processor.h"
 
 namespace dsp {
+    // Runs a list of blocks back-to-back on a single thread using their direct processing
+    template<class T>
+    class FusedChainRunner : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        FusedChainRunner() {}
+
+        ~FusedChainRunner() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(scratch);
+        }
+
+        void init(stream<T>* in) {
+            base_type::init(in);
+            base_type::sizeOutput();
+        }
+
+        void setBlocks(const std::vector<Processor<T, T>*>& blocks) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _blocks = blocks;
+            base_type::tempStart();
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            // Any block may write to either buffer, so both must fit the largest output of the chain
+            int needed = 0;
+            int blockOut = count;
+            for (const auto& blk : _blocks) {
+                blockOut = blk->maxDirectOutputCount(blockOut);
+                needed = std::max<int>(needed, blockOut);
+            }
+            buffer::grow(scratch, scratchSize, needed);
+            if (!base_type::reserveOutput(needed)) { return -1; }
+
+            // Ping-pong between the scratch buffer and the output buffer so that no block ever
+            // processes in place, the parity is chosen so that the last block writes to the output.
+            const T* data = base_type::_in->readBuf;
+            int blockCount = _blocks.size();
+            for (int i = 0; i < blockCount && count > 0; i++) {
+                T* dst = ((blockCount - 1 - i) & 1) ? scratch : base_type::out.writeBuf;
+                count = _blocks[i]->processDirect(count, data, dst);
+                data = dst;
+            }
+
+            base_type::_in->flush();
+            if (count > 0) {
+                if (!base_type::out.swap(count)) { return -1; }
+            }
+            return count;
+        }
+
+    protected:
+        std::vector<Processor<T, T>*> _blocks;
+        T* scratch = NULL;
+        int scratchSize = 0;
+    };
+
     template<class T>
     class chain {
     public:
@@ -19,6 +82,11 @@ namespace dsp {
         template<typename Func>
         void setInput(stream<T>* in, Func onOutputChange) {
             _in = in;
+            if (fused) {
+                runner.setInput(_in);
+                updateFused(onOutputChange);
+                return;
+            }
             for (auto& ln : links) {
                 if (states[ln]) {
                     ln->setInput(_in);
@@ -35,6 +103,11 @@ namespace dsp {
                 throw std::runtime_error("[chain] Tried to add a block that is already part of the chain");
             }
 
+            // Check that the block can be run by a fused chain
+            if (fused && !block->canProcessDirect()) {
+                throw std::runtime_error("[chain] Tried to add a block without direct processing to a fused chain");
+            }
+
             // Add to the list
             links.push_back(block);
             states[block] = false;
@@ -68,6 +141,13 @@ namespace dsp {
             // If already enable, don't do anything
             if (states[block]) { return; }
 
+            // In fused mode, only the runner needs to be updated
+            if (fused) {
+                states[block] = true;
+                updateFused(onOutputChange);
+                return;
+            }
+
             // Gather blocks before and after the block to enable
             Processor<T, T>* before = blockBefore(block);
             Processor<T, T>* after = blockAfter(block);
@@ -99,6 +179,13 @@ namespace dsp {
             // If already disabled, don't do anything
             if (!states[block]) { return; }
 
+            // In fused mode, only the runner needs to be updated
+            if (fused) {
+                states[block] = false;
+                updateFused(onOutputChange);
+                return;
+            }
+
             // Stop disabled block
             block->stop();
             states[block] = false;
@@ -141,8 +228,69 @@ namespace dsp {
             }
         }
 
+        /**
+         * Run all enabled blocks on a single thread by calling their direct processing back-to-back
+         * instead of starting one worker thread per block. All blocks of the chain must support
+         * direct processing. Must be called after init().
+         */
+        template<typename Func>
+        void setFused(bool enabled, Func onOutputChange) {
+            if (enabled == fused) { return; }
+
+            // Check that all blocks can be run by a fused chain
+            if (enabled) {
+                for (auto& ln : links) {
+                    if (!ln->canProcessDirect()) {
+                        throw std::runtime_error("[chain] Tried to fuse a chain containing a block without direct processing");
+                    }
+                }
+            }
+
+            // Switch mode while stopped
+            bool wasRunning = running;
+            stop();
+            fused = enabled;
+            if (fused) {
+                if (!runnerInit) {
+                    runner.init(_in);
+                    runnerInit = true;
+                }
+                else {
+                    runner.setInput(_in);
+                }
+                updateFused(onOutputChange);
+            }
+            else {
+                relink(onOutputChange);
+            }
+            if (wasRunning) { start(); }
+        }
+
+        bool isFused() {
+            return fused;
+        }
+
+        /**
+         * Switch the output of the fused runner to the ring transport, see stream::setRingMode().
+         * The chain must be fused and stopped.
+         */
+        void setRingMode(int slots, StreamWaitPolicy policy = STREAM_WAIT_SPIN) {
+            if (!fused) {
+                throw std::runtime_error("[chain] Tried to set the ring mode of a chain that isn't fused");
+            }
+            if (running) {
+                throw std::runtime_error("[chain] Tried to set the ring mode of a running chain");
+            }
+            runner.out.setRingMode(slots, policy);
+        }
+
         void start() {
             if (running) { return; }
+            if (fused) {
+                if (out != _in) { runner.start(); }
+                running = true;
+                return;
+            }
             for (auto& ln : links) {
                 if (!states[ln]) { continue; }
                 ln->start();
@@ -152,6 +300,11 @@ namespace dsp {
 
         void stop() {
             if (!running) { return; }
+            if (fused) {
+                runner.stop();
+                running = false;
+                return;
+            }
             for (auto& ln : links) {
                 if (!states[ln]) { continue; }
                 ln->stop();
@@ -162,6 +315,51 @@ namespace dsp {
         stream<T>* out;
 
     private:
+        template<typename Func>
+        void updateFused(Func onOutputChange) {
+            // Give the runner the list of enabled blocks
+            std::vector<Processor<T, T>*> enabled;
+            for (auto& ln : links) {
+                if (states[ln]) { enabled.push_back(ln); }
+            }
+            runner.setBlocks(enabled);
+
+            // The runner is bypassed entirely when no block is enabled
+            stream<T>* newOut = enabled.empty() ? _in : &runner.out;
+            if (running) {
+                if (enabled.empty()) {
+                    runner.stop();
+                }
+                else {
+                    runner.start();
+                }
+            }
+
+            // Update output
+            if (newOut != out) {
+                out = newOut;
+                onOutputChange(out);
+            }
+        }
+
+        template<typename Func>
+        void relink(Func onOutputChange) {
+            // Reconnect the enabled blocks to each other
+            Processor<T, T>* last = NULL;
+            for (auto& ln : links) {
+                if (!states[ln]) { continue; }
+                ln->setInput(last ? &last->out : _in);
+                last = ln;
+            }
+
+            // Update output
+            stream<T>* newOut = last ? &last->out : _in;
+            if (newOut != out) {
+                out = newOut;
+                onOutputChange(out);
+            }
+        }
+
         Processor<T, T>* blockBefore(Processor<T, T>* block) {
             // TODO: This is wrong and must be fixed when I get more time
             for (auto& ln : links) {
@@ -191,5 +389,9 @@ namespace dsp {
         std::vector<Processor<T, T>*> links;
         std::map<Processor<T, T>*, bool> states;
         bool running = false;
+
+        FusedChainRunner<T> runner;
+        bool runnerInit = false;
+        bool fused = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,242 @@
+#pragma once
+#include "../sink.h"
+#include "../fft/plan_cache.h"
+#include "../taps/low_pass.h"
+
+// Fraction of the channel spacing, on each side of a channel center, where the channelizer response is flat
+#define CHANNELIZER_PASSBAND 0.75
+
+namespace dsp::channel {
+    /**
+     * 2x oversampled polyphase filter bank. Splits its input into channelCount channels spaced by
+     * samplerate / channelCount, channel k being centered on k * samplerate / channelCount. Each channel
+     * comes out at 2 * samplerate / channelCount and only the channels that have a stream bound are written.
+     */
+    class Channelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        Channelizer() {}
+
+        Channelizer(stream<complex_t>* in, int channels) { init(in, channels); }
+
+        ~Channelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            destroyBank();
+            buffer::free(buffer);
+        }
+
+        void init(stream<complex_t>* in, int channels) {
+            buildBank(channels);
+            base_type::init(in);
+        }
+
+        void setChannelCount(int channels) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            for (const auto& o : outputs) {
+                if (o.channel >= channels) {
+                    throw std::runtime_error("[Channelizer] Tried to change channel count while a stream is bound to a removed channel");
+                }
+            }
+            destroyBank();
+            buildBank(channels);
+            base_type::tempStart();
+        }
+
+        int getChannelCount() {
+            return _channels;
+        }
+
+        void bindStream(int channel, stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the channel exists and that the stream isn't already bound
+            if (channel < 0 || channel >= _channels) {
+                throw std::runtime_error("[Channelizer] Tried to bind stream to a channel that doesn't exist");
+            }
+            if (findOutput(stream) != outputs.end()) {
+                throw std::runtime_error("[Channelizer] Tried to bind stream to that is already bound");
+            }
+
+            // Add to the list
+            base_type::tempStop();
+            base_type::registerOutput(stream);
+            outputs.push_back({ stream, channel });
+            base_type::tempStart();
+        }
+
+        void unbindStream(stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the stream is bound
+            auto oit = findOutput(stream);
+            if (oit == outputs.end()) {
+                throw std::runtime_error("[Channelizer] Tried to unbind stream to that isn't bound");
+            }
+
+            // Remove from the list
+            base_type::tempStop();
+            outputs.erase(oit);
+            base_type::unregisterOutput(stream);
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            buffer::clear(buffer, histSize);
+            offset = 0;
+            oddOutput = false;
+            base_type::tempStart();
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            // Make sure every output can hold what this block produces
+            int maxOutCount = (count / decim) + 1;
+            for (const auto& o : outputs) {
+                if (!o.dest->reserve(maxOutCount)) {
+                    base_type::_in->flush();
+                    return -1;
+                }
+            }
+
+            // Append the input to the delay line
+            if (buffer::grow(buffer, bufSize, count + histSize, histSize)) {
+                bufStart = &buffer[histSize];
+            }
+            memcpy(bufStart, base_type::_in->readBuf, count * sizeof(complex_t));
+            base_type::_in->flush();
+
+            // Nobody is listening, just keep track of the output phase
+            if (outputs.empty()) {
+                for (; offset < count; offset += decim) { oddOutput = !oddOutput; }
+                offset -= count;
+                memmove(buffer, &buffer[count], histSize * sizeof(complex_t));
+                return 0;
+            }
+
+            int outCount = 0;
+            for (; offset < count; offset += decim) {
+                // Sum the branches, each tap of every branch is a contiguous segment of the delay line
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)fftIn, (lv_32fc_t*)&buffer[offset + (tapsPerBranch - 1) * _channels], bank[0], _channels);
+                for (int p = 1; p < tapsPerBranch; p++) {
+                    volk_32fc_32f_multiply_32fc((lv_32fc_t*)product, (lv_32fc_t*)&buffer[offset + (tapsPerBranch - 1 - p) * _channels], bank[p], _channels);
+                    volk_32f_x2_add_32f((float*)fftIn, (float*)fftIn, (float*)product, 2 * _channels);
+                }
+
+                // One FFT gives every channel at once
+                fftwf_execute_dft(plan, (fftwf_complex*)fftIn, (fftwf_complex*)fftOut);
+
+                // Undo the reversed branch order, odd outputs of odd channels are also rotated by pi due to the oversampling
+                for (const auto& o : outputs) {
+                    complex_t val = fftOut[o.channel] * rotation[o.channel];
+                    o.dest->writeBuf[outCount] = (oddOutput && (o.channel & 1)) ? (val * -1.0f) : val;
+                }
+                oddOutput = !oddOutput;
+                outCount++;
+            }
+            offset -= count;
+
+            // Move the history to the front of the delay line
+            memmove(buffer, &buffer[count], histSize * sizeof(complex_t));
+
+            // Send out the channels
+            if (!outCount) { return 0; }
+            for (const auto& o : outputs) {
+                if (!o.dest->swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        struct Output {
+            stream<complex_t>* dest;
+            int channel;
+        };
+
+        std::vector<Output>::iterator findOutput(stream<complex_t>* stream) {
+            return std::find_if(outputs.begin(), outputs.end(), [stream](const Output& o) { return o.dest == stream; });
+        }
+
+        void buildBank(int channels) {
+            if (channels < 2 || (channels % 2)) {
+                throw std::runtime_error("[Channelizer] Channel count must be even");
+            }
+            _channels = channels;
+            decim = _channels / 2;
+
+            // Prototype lowpass, flat up to CHANNELIZER_PASSBAND channel spacings and rejecting anything that would alias into it
+            double transWidth = 2.0 * (1.0 - CHANNELIZER_PASSBAND);
+            tap<float> proto = taps::lowPass(1.0, transWidth, _channels);
+            tapsPerBranch = (proto.size + _channels - 1) / _channels;
+
+            // Branch p holds the p-th tap of every branch in reverse order so that it lines up with the delay line
+            bank = new float*[tapsPerBranch];
+            for (int p = 0; p < tapsPerBranch; p++) {
+                bank[p] = buffer::alloc<float>(_channels);
+                for (int j = 0; j < _channels; j++) {
+                    int id = (_channels - 1 - j) + (p * _channels);
+                    bank[p][j] = (id < proto.size) ? proto.taps[id] : 0.0f;
+                }
+            }
+            taps::free(proto);
+
+            // The reversed branch order shows up as a rotation of each channel
+            rotation = buffer::alloc<complex_t>(_channels);
+            for (int k = 0; k < _channels; k++) {
+                double phase = -2.0 * FL_M_PI * (double)k / (double)_channels;
+                rotation[k] = { (float)cos(phase), (float)sin(phase) };
+            }
+
+            fftIn = (complex_t*)fftwf_malloc(_channels * sizeof(complex_t));
+            fftOut = (complex_t*)fftwf_malloc(_channels * sizeof(complex_t));
+            product = buffer::alloc<complex_t>(_channels);
+            plan = fft::planCache.dft(_channels, fftIn, fftOut, FFTW_FORWARD);
+
+            // Start from a clean history
+            histSize = (tapsPerBranch * _channels) - 1;
+            buffer::grow(buffer, bufSize, histSize);
+            bufStart = &buffer[histSize];
+            buffer::clear(buffer, histSize);
+            offset = 0;
+            oddOutput = false;
+        }
+
+        void destroyBank() {
+            for (int p = 0; p < tapsPerBranch; p++) { buffer::free(bank[p]); }
+            delete[] bank;
+            buffer::free(rotation);
+            buffer::free(product);
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+        }
+
+        int _channels;
+        int decim;
+        int tapsPerBranch = 0;
+        float** bank = NULL;
+        complex_t* rotation;
+
+        complex_t* fftIn;
+        complex_t* fftOut;
+        complex_t* product;
+        fftwf_plan plan;
+
+        complex_t* buffer = NULL;
+        complex_t* bufStart;
+        int bufSize = 0;
+        int histSize;
+        int offset = 0;
+        bool oddOutput = false;
+
+        std::vector<Output> outputs;
+    };
+}
@@ -29,6 +29,9 @@ namespace dsp::channel {
             generateTaps();
             filter.init(NULL, ftaps);
 
+            // Size the output from the rate instead of the worst case, run() grows it if blocks get larger
+            out.setBufferSize(streamBufferSizeFor(std::max<double>(_inSamplerate, _outSamplerate)));
+
             base_type::init(in);
         }
 
@@ -103,6 +106,13 @@ namespace dsp::channel {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            // The output buffer first holds the translated input, then the resampled output
+            int needed = std::max<int>(count, ceil((double)count * _outSamplerate / _inSamplerate) + 1);
+            if (!out.reserve(needed)) {
+                base_type::_in->flush();
+                return -1;
+            }
+
             int outCount = process(count, base_type::_in->readBuf, out.writeBuf);
 
             // Swap if some data was generated
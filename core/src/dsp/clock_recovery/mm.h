@@ -31,10 +31,14 @@ namespace dsp::clock_recovery {
 
             pcl.init(_muGain, _omegaGain, 0.0, 0.0, 1.0, _omega, _omega * (1.0 - omegaRelLimit), _omega * (1.0 + omegaRelLimit));
             generateInterpTaps();
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + _interpTapCount);
+
+            // Allocate and clear the delay buffer, it grows to fit the largest input seen
+            buffer::grow(buffer, bufSize, _interpTapCount - 1);
             bufStart = &buffer[_interpTapCount - 1];
+            buffer::clear(buffer, _interpTapCount - 1);
         
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         void setOmega(double omega) {
@@ -78,9 +82,12 @@ namespace dsp::clock_recovery {
             _interpTapCount = interpTapCount;
             dsp::multirate::freePolyphaseBank(interpBank);
             buffer::free(buffer);
+            buffer = NULL;
+            bufSize = 0;
             generateInterpTaps();
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + _interpTapCount);
+            buffer::grow(buffer, bufSize, _interpTapCount - 1);
             bufStart = &buffer[_interpTapCount - 1];
+            buffer::clear(buffer, _interpTapCount - 1);
             base_type::tempStart();
         }
 
@@ -98,7 +105,10 @@ namespace dsp::clock_recovery {
         }
 
         inline int process(int count, const T* in, T* out) {
-            // Copy data to work buffer
+            // Copy data to work buffer, growing it if the input is larger than anything seen so far
+            if (buffer::grow(buffer, bufSize, count + _interpTapCount - 1, _interpTapCount - 1)) {
+                bufStart = &buffer[_interpTapCount - 1];
+            }
             memcpy(bufStart, in, count * sizeof(T));
 
             // Process all samples
@@ -155,10 +165,17 @@ namespace dsp::clock_recovery {
             return outCount;
         }
 
+        // At most one symbol comes out per shortest symbol period the loop can settle on
+        int maxOutputCount(int count) {
+            return ceil((double)count / (_omega * (1.0 - _omegaRelLimit))) + 1;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            if (!base_type::reserveOutput(maxOutputCount(count))) { return -1; }
+
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
             // Swap if some data was generated
@@ -193,7 +210,8 @@ namespace dsp::clock_recovery {
         complex_t _c_0T = { 0.0f, 0.0f }, _c_1T = { 0.0f, 0.0f }, _c_2T = { 0.0f, 0.0f };
 
         int offset = 0;
-        T* buffer;
+        T* buffer = NULL;
         T* bufStart;
+        int bufSize = 0;
     };
 }
\ No newline at end of file
@@ -4,6 +4,22 @@ namespace dsp::compression {
     enum PCMType {
         PCM_TYPE_I8,
         PCM_TYPE_I16,
-        PCM_TYPE_F32
+        PCM_TYPE_F32,
+
+        // Block floating point (see bfp_codec.h), the low nibble is the number of bits per component
+        PCM_TYPE_BFP4 = 0x14,
+        PCM_TYPE_BFP6 = 0x16,
+        PCM_TYPE_BFP8 = 0x18,
+        PCM_TYPE_BFP10 = 0x1A,
+        PCM_TYPE_BFP12 = 0x1C
     };
-}
\ No newline at end of file
+
+    inline bool isBFPType(int pcmType) {
+        int bits = pcmType & 0x0F;
+        return (pcmType & ~0x0F) == 0x10 && bits >= 4 && bits <= 12;
+    }
+
+    inline int bfpBits(int pcmType) {
+        return pcmType & 0x0F;
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "pcm_type.h"
+#include "bfp_codec.h"
 
 namespace dsp::compression {
     class SampleStreamCompressor : public Processor<complex_t, uint8_t> {
@@ -13,7 +14,7 @@ namespace dsp::compression {
         void init(stream<complex_t>* in, PCMType pcmType) {
             _pcmType = pcmType;
 
-            // Set the output buffer size to the max size of a complex buffer + 8 bytes for the header
+            // Set the output buffer size to the max size of a complex buffer + 8 bytes for the header (BFP never codes larger than float)
             out.setBufferSize(STREAM_BUFFER_SIZE*sizeof(complex_t) + 8);
 
             base_type::init(in);
@@ -44,6 +45,12 @@ namespace dsp::compression {
                 return 8 + (count * sizeof(complex_t));
             }
 
+            // Block floating point has its own scaling, the scaler field holds the sample count instead
+            if (isBFPType(pcmType)) {
+                *(uint32_t*)scaler = count;
+                return 8 + encodeBFP(in, count, bfpBits(pcmType), (uint8_t*)dataBuf);
+            }
+
             // Find maximum value
             uint32_t maxIdx;
             volk_32f_index_max_32u(&maxIdx, (float*)in, count * 2);
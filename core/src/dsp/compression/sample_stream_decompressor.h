@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "pcm_type.h"
+#include "bfp_codec.h"
 
 namespace dsp::compression {
     class SampleStreamDecompressor : public Processor<uint8_t, complex_t> {
@@ -10,7 +11,10 @@ namespace dsp::compression {
 
         SampleStreamDecompressor(stream<uint8_t>* in) { base_type::init(in); }
 
-        inline int process(int count, const uint8_t* in, complex_t* out) {
+        inline static int process(int count, const uint8_t* in, complex_t* out) {
+            // Drop buffers too short to even hold the header
+            if (count < 8) { return 0; }
+
             uint16_t sampleType = *(uint16_t*)&in[2];
             float scaler = *(float*)&in[4];
             const void* dataBuf = &in[8];
@@ -29,6 +33,14 @@ namespace dsp::compression {
                 volk_8i_s32f_convert_32f((float*)out, (int8_t*)dataBuf, 128.0f / scaler, outCount * 2);
                 return outCount;
             }
+            else if (isBFPType(sampleType)) {
+                // Reject sample counts that don't fit the output or that the data is too short to hold
+                uint32_t outCount = *(uint32_t*)&in[4];
+                if (!outCount || outCount > STREAM_BUFFER_SIZE) { return 0; }
+                if (count - 8 < bfpMinEncodedSize(outCount)) { return 0; }
+                if (!decodeBFP((const uint8_t*)dataBuf, count - 8, outCount, bfpBits(sampleType), out)) { return 0; }
+                return outCount;
+            }
             
             return 0;
         }
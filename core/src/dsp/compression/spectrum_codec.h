@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+
+// Anything below this level in dB is clamped before quantization
+#define SPECTRUM_CODEC_FLOOR    -200.0f
+
+namespace dsp::compression {
+    enum SpectrumFlags {
+        SPECTRUM_FLAG_DELTA = (1 << 0)
+    };
+
+#pragma pack(push, 1)
+    struct SpectrumHeader {
+        float min;      // Level of code 0 in dB
+        float step;     // dB per code
+        uint16_t count;
+        uint8_t flags;
+    };
+#pragma pack(pop)
+
+    /**
+     * Quantize a line of dB values to one byte per bin between the line's min and max. With delta coding, each
+     * byte is the difference with the previous bin instead, which compresses much better on smooth spectra.
+     * Returns the number of bytes written, out must hold sizeof(SpectrumHeader) + count bytes.
+     */
+    inline int encodeSpectrum(const float* in, int count, uint8_t* out, bool delta) {
+        SpectrumHeader* hdr = (SpectrumHeader*)out;
+        uint8_t* codes = &out[sizeof(SpectrumHeader)];
+
+        // Find the range of the line
+        float min = INFINITY;
+        float max = SPECTRUM_CODEC_FLOOR;
+        for (int i = 0; i < count; i++) {
+            float val = std::max<float>(in[i], SPECTRUM_CODEC_FLOOR);
+            min = std::min<float>(min, val);
+            max = std::max<float>(max, val);
+        }
+        if (!count) { min = SPECTRUM_CODEC_FLOOR; }
+        float step = std::max<float>(max - min, 1e-3f) / 255.0f;
+
+        hdr->min = min;
+        hdr->step = step;
+        hdr->count = count;
+        hdr->flags = delta ? SPECTRUM_FLAG_DELTA : 0;
+
+        // Quantize
+        float scale = 1.0f / step;
+        uint8_t last = 0;
+        for (int i = 0; i < count; i++) {
+            float val = std::max<float>(in[i], SPECTRUM_CODEC_FLOOR);
+            uint8_t code = (uint8_t)std::clamp<float>(roundf((val - min) * scale), 0.0f, 255.0f);
+            codes[i] = delta ? (uint8_t)(code - last) : code;
+            last = code;
+        }
+
+        return sizeof(SpectrumHeader) + count;
+    }
+
+    // Returns the number of bins written to out or -1 if the data is invalid or doesn't fit in maxCount bins
+    inline int decodeSpectrum(const uint8_t* in, int len, float* out, int maxCount) {
+        if (len < sizeof(SpectrumHeader)) { return -1; }
+        const SpectrumHeader* hdr = (const SpectrumHeader*)in;
+        const uint8_t* codes = &in[sizeof(SpectrumHeader)];
+        int count = hdr->count;
+        if (count > maxCount || len < sizeof(SpectrumHeader) + count) { return -1; }
+
+        bool delta = hdr->flags & SPECTRUM_FLAG_DELTA;
+        uint8_t code = 0;
+        for (int i = 0; i < count; i++) {
+            code = delta ? (uint8_t)(code + codes[i]) : codes[i];
+            out[i] = hdr->min + ((float)code * hdr->step);
+        }
+
+        return count;
+    }
+}
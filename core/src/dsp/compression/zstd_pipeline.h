@@ -0,0 +1,262 @@
+#pragma once
+#include <zstd.h>
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+
+// Bounds of the adaptive compression level, negative levels are zstd's fast modes
+#define ZSTD_PIPELINE_MIN_LEVEL     -5
+#define ZSTD_PIPELINE_MAX_LEVEL     9
+#define ZSTD_PIPELINE_START_LEVEL   1
+
+// Number of frames between two compression level adjustments
+#define ZSTD_PIPELINE_ADAPT_FRAMES  32
+
+namespace dsp::compression {
+    /**
+     * Compresses frames on a pool of worker threads, each with its own zstd context, and hands them over in
+     * the order they were pushed. The input is bounded, frames pushed while the pipeline is full are dropped
+     * so that a slow CPU or link never blocks the producer.
+     *
+     * The level adapts to the load: it goes down when the workers can't keep up and up when the link is
+     * the bottleneck and there's CPU to spare. The handler gets a buffer with headroom free bytes before
+     * the payload for the caller's packet header. Frames that don't get smaller are handed over uncompressed.
+     */
+    class ZstdPipeline {
+    public:
+        struct Stats {
+            uint64_t frames = 0;
+            uint64_t dropped = 0;
+            uint64_t rawBytes = 0;          // Input of the frames that were compressed
+            uint64_t compressedBytes = 0;   // Output of the frames that were compressed
+            int queuedFrames = 0;
+            int queuedBytes = 0;
+            int level = ZSTD_PIPELINE_START_LEVEL;
+            float cpuLoad = 0.0f;           // Fraction of the workers' time spent compressing
+        };
+
+        typedef void (*Handler)(uint8_t* buf, int len, bool compressed, void* ctx);
+
+        ZstdPipeline() {}
+
+        ~ZstdPipeline() {
+            stop();
+        }
+
+        void init(int threads, int maxQueuedBytes, int maxFrameSize, int headroom, Handler handler, void* ctx) {
+            _threads = std::max<int>(threads, 1);
+            _maxQueuedBytes = maxQueuedBytes;
+            _maxFrameSize = maxFrameSize;
+            _headroom = headroom;
+            _handler = handler;
+            _ctx = ctx;
+        }
+
+        void start() {
+            if (running) { return; }
+            stopping = false;
+            windowStart = std::chrono::steady_clock::now();
+            for (int i = 0; i < _threads; i++) {
+                workers.push_back(std::thread(&ZstdPipeline::worker, this));
+            }
+            running = true;
+        }
+
+        void stop() {
+            if (!running) { return; }
+            // Workers take emitMtx then jobMtx, so never hold both here
+            {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                stopping = true;
+            }
+            jobCnd.notify_all();
+            {
+                std::lock_guard<std::mutex> lck(emitMtx);
+            }
+            emitCnd.notify_all();
+            for (auto& w : workers) { w.join(); }
+            workers.clear();
+
+            // Discard whatever was left
+            std::lock_guard<std::mutex> lck(jobMtx);
+            for (auto& job : jobs) { freeBufs.push_back(std::move(job.data)); }
+            jobs.clear();
+            stats.queuedFrames = 0;
+            stats.queuedBytes = 0;
+            nextEmit = nextSeq;
+            running = false;
+        }
+
+        // Returns false if the frame was dropped
+        bool push(const uint8_t* data, int len, bool compress) {
+            {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                if (!running || len > _maxFrameSize) { return false; }
+                if (stats.queuedBytes + len > _maxQueuedBytes) {
+                    stats.dropped++;
+                    return false;
+                }
+
+                // Reuse the buffers of past frames to avoid allocating on every push
+                Job job;
+                if (!freeBufs.empty()) {
+                    job.data = std::move(freeBufs.back());
+                    freeBufs.pop_back();
+                }
+                job.data.assign(data, data + len);
+                job.compress = compress;
+                job.seq = nextSeq++;
+                jobs.push_back(std::move(job));
+                stats.queuedFrames++;
+                stats.queuedBytes += len;
+            }
+            jobCnd.notify_one();
+            return true;
+        }
+
+        // Fraction of the link's send queue in use, from 0 to 1
+        void setLinkLoad(float load) {
+            linkLoad = load;
+        }
+
+        Stats getStats() {
+            std::lock_guard<std::mutex> lck(jobMtx);
+            Stats s = stats;
+            s.level = level;
+            s.cpuLoad = cpuLoad;
+            return s;
+        }
+
+    private:
+        struct Job {
+            std::vector<uint8_t> data;
+            bool compress;
+            uint64_t seq;
+        };
+
+        void worker() {
+            ZSTD_CCtx* cctx = ZSTD_createCCtx();
+            int outSize = _headroom + ZSTD_compressBound(_maxFrameSize);
+            uint8_t* out = new uint8_t[outSize];
+
+            while (true) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lck(jobMtx);
+                    jobCnd.wait(lck, [this]() { return !jobs.empty() || stopping; });
+                    if (stopping) { break; }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                // Compress, keeping the frame as is if it doesn't get any smaller
+                int inLen = job.data.size();
+                int len = inLen;
+                bool compressed = false;
+                auto begin = std::chrono::steady_clock::now();
+                if (job.compress) {
+                    size_t clen = ZSTD_compressCCtx(cctx, &out[_headroom], outSize - _headroom, job.data.data(), inLen, level);
+                    if (!ZSTD_isError(clen) && clen < inLen) {
+                        len = clen;
+                        compressed = true;
+                    }
+                }
+                if (!compressed) { memcpy(&out[_headroom], job.data.data(), inLen); }
+                double busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+                // Hand over in order
+                {
+                    std::unique_lock<std::mutex> lck(emitMtx);
+                    emitCnd.wait(lck, [this, &job]() { return nextEmit == job.seq || stopping; });
+                    if (stopping) { break; }
+                    _handler(out, len, compressed, _ctx);
+                    nextEmit++;
+                    adapt(busy);
+                }
+                emitCnd.notify_all();
+
+                {
+                    std::lock_guard<std::mutex> lck(jobMtx);
+                    stats.frames++;
+                    stats.queuedFrames--;
+                    stats.queuedBytes -= inLen;
+                    if (compressed) {
+                        stats.rawBytes += inLen;
+                        stats.compressedBytes += len;
+                    }
+                    freeBufs.push_back(std::move(job.data));
+                }
+            }
+
+            ZSTD_freeCCtx(cctx);
+            delete[] out;
+        }
+
+        // Must be called with emitMtx held
+        void adapt(double busy) {
+            windowBusy += busy;
+            if (++windowFrames < ZSTD_PIPELINE_ADAPT_FRAMES) { return; }
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - windowStart).count();
+            float load = (elapsed > 0.0) ? (float)(windowBusy / (elapsed * (double)_threads)) : 1.0f;
+            cpuLoad = load;
+            windowStart = now;
+            windowBusy = 0.0;
+            windowFrames = 0;
+
+            int queued;
+            {
+                std::lock_guard<std::mutex> lck(jobMtx);
+                queued = stats.queuedBytes;
+            }
+
+            // Back off if the workers are falling behind, compress harder if the link is the one that is
+            int lvl = level;
+            if (load > 0.8f || queued > _maxQueuedBytes / 2) {
+                lvl--;
+            }
+            else if (linkLoad > 0.25f && load < 0.5f) {
+                lvl++;
+            }
+            level = std::clamp<int>(lvl, ZSTD_PIPELINE_MIN_LEVEL, ZSTD_PIPELINE_MAX_LEVEL);
+        }
+
+        int _threads = 1;
+        int _maxQueuedBytes = 0;
+        int _maxFrameSize = 0;
+        int _headroom = 0;
+        Handler _handler = NULL;
+        void* _ctx = NULL;
+
+        bool running = false;
+        std::atomic<bool> stopping = false;
+        std::vector<std::thread> workers;
+
+        std::mutex jobMtx;
+        std::condition_variable jobCnd;
+        std::deque<Job> jobs;
+        std::vector<std::vector<uint8_t>> freeBufs;
+        uint64_t nextSeq = 0;
+        Stats stats;
+
+        std::mutex emitMtx;
+        std::condition_variable emitCnd;
+        uint64_t nextEmit = 0;
+
+        // Level adaptation
+        std::atomic<int> level = ZSTD_PIPELINE_START_LEVEL;
+        std::atomic<float> linkLoad = 0.0f;
+        std::atomic<float> cpuLoad = 0.0f;
+        std::chrono::steady_clock::time_point windowStart;
+        double windowBusy = 0.0;
+        int windowFrames = 0;
+    };
+}
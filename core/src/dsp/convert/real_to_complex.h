@@ -16,12 +16,15 @@ namespace dsp::convert {
         }
 
         void init(stream<float>* in) {
-            nullBuf = buffer::alloc<float>(STREAM_BUFFER_SIZE);
-            buffer::clear(nullBuf, STREAM_BUFFER_SIZE);
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         inline int process(int count, const float* in, complex_t* out) {
+            // The imaginary part comes from a buffer of zeros as long as the largest input seen
+            if (buffer::grow(nullBuf, nullBufSize, count)) {
+                buffer::clear(nullBuf, nullBufSize);
+            }
             volk_32f_x2_interleave_32fc((lv_32fc_t*)out, in, nullBuf, count);
             return count;
         }
@@ -29,6 +32,7 @@ namespace dsp::convert {
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(count)) { return -1; }
 
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
@@ -38,7 +42,8 @@ namespace dsp::convert {
         }
 
     private:
-        float* nullBuf;
+        float* nullBuf = NULL;
+        int nullBufSize = 0;
 
     };
 }
\ No newline at end of file
@@ -59,6 +59,8 @@ namespace dsp::correction {
             return count;
         }
 
+        bool canProcessDirect() { return true; }
+
         virtual int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -71,6 +73,10 @@ namespace dsp::correction {
         }
 
     protected:
+        int directProcess(int count, const T* in, T* out) {
+            return process(count, (T*)in, out);
+        }
+
         float _rate;
         T offset;
     };
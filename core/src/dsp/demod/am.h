@@ -44,6 +44,7 @@ namespace dsp::demod {
             lpf.out.free();
             
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         void setAGCMode(AGCMode agcMode) {
@@ -135,6 +136,7 @@ namespace dsp::demod {
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(count)) { return -1; }
 
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
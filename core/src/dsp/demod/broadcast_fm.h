@@ -52,17 +52,22 @@ namespace dsp::demod {
             xlator.init(NULL, -57000.0, samplerate);
             rdsResamp.init(NULL, samplerate, 5000.0);
 
-            lmr = buffer::alloc<float>(STREAM_BUFFER_SIZE);
-            l = buffer::alloc<float>(STREAM_BUFFER_SIZE);
-            r = buffer::alloc<float>(STREAM_BUFFER_SIZE);
-
             lprDelay.out.free();
             arFir.out.free();
             alFir.out.free();
             xlator.out.free();
             rdsResamp.out.free();
 
+            // The outputs of the other inner blocks are only used as work buffers, process() grows them with the input
+            demod.out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+            rtoc.out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+            pilotFir.out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+            pilotPLL.out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+            lmrDelay.out.setBufferSize(STREAM_MIN_BUFFER_SIZE);
+
             base_type::init(in);
+            base_type::sizeOutput();
+            if (in) { this->rdsOut.setBufferSize(std::max<int>(rdsResamp.maxOutputCount(in->getBufferSize()), STREAM_MIN_BUFFER_SIZE)); }
         }
 
         void setDeviation(double deviation) {
@@ -142,6 +147,16 @@ namespace dsp::demod {
         }
 
         inline int process(int count, complex_t* in, stereo_t* out, int& rdsOutCount, complex_t* rdsout = NULL) {
+            // Make sure the work buffers can hold the input
+            buffer::grow(lmr, lmrSize, count);
+            buffer::grow(l, lSize, count);
+            buffer::grow(r, rSize, count);
+            demod.out.reserve(count);
+            rtoc.out.reserve(count);
+            pilotFir.out.reserve(count);
+            pilotPLL.out.reserve(count);
+            lmrDelay.out.reserve(count);
+
             // Demodulate
             demod.process(count, in, demod.out.writeBuf);
             if (_stereo) {
@@ -217,6 +232,11 @@ namespace dsp::demod {
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(count)) { return -1; }
+            if (_rdsOut && !rdsOut.reserve(rdsResamp.maxOutputCount(count))) {
+                base_type::_in->flush();
+                return -1;
+            }
 
             int rdsOutCount = 0;
             process(count, base_type::_in->readBuf, base_type::out.writeBuf, rdsOutCount, rdsOut.writeBuf);
@@ -251,9 +271,12 @@ namespace dsp::demod {
         filter::FIR<float, float> alFir;
         multirate::RationalResampler<dsp::complex_t> rdsResamp;
 
-        float* lmr;
-        float* l;
-        float* r;
+        float* lmr = NULL;
+        float* l = NULL;
+        float* r = NULL;
+        int lmrSize = 0;
+        int lSize = 0;
+        int rSize = 0;
         
     };
 }
\ No newline at end of file
@@ -41,6 +41,7 @@ namespace dsp::demod {
             fir.out.free();
 
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         void setSamplerate(double samplerate) {
@@ -105,6 +106,7 @@ namespace dsp::demod {
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(count)) { return -1; }
 
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
@@ -18,6 +18,7 @@ namespace dsp::demod {
         virtual void init(stream<complex_t>* in, double deviation) {
             _invDeviation = 1.0 / deviation;
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         virtual void init(stream<complex_t>* in, double deviation, double samplerate) {
@@ -54,6 +55,7 @@ namespace dsp::demod {
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(count)) { return -1; }
 
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
@@ -33,6 +33,7 @@ namespace dsp::demod {
             }
 
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         void setMode(Mode mode) {
@@ -94,6 +95,7 @@ namespace dsp::demod {
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(count)) { return -1; }
 
             process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
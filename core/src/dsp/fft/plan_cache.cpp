@@ -0,0 +1,5 @@
+#include "plan_cache.h"
+
+namespace dsp::fft {
+    PlanCache planCache;
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include <fftw3.h>
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string.h>
+#include <module.h>
+#include "../types.h"
+
+// Longest a measurement may hold the planner, in seconds
+#define PLAN_CACHE_MEASURE_TIMELIMIT    0.1
+
+namespace dsp::fft {
+    enum PlanMode {
+        PLAN_MODE_ESTIMATE,
+        PLAN_MODE_MEASURE
+    };
+
+    /**
+     * Process wide cache of FFTW plans keyed by kind, size, direction, batch count, placement and alignment.
+     * Plans belong to the cache and stay valid until it's destroyed. Since they're shared, they must only be
+     * run through the new-array execute functions (fftwf_execute_dft, fftwf_execute_dft_r2c and
+     * fftwf_execute_dft_c2r) on buffers laid out like the ones given when getting the plan.
+     *
+     * In measure mode, a missing plan is served from wisdom if possible, otherwise an estimated plan is
+     * returned right away and a measured one is made in the background, replacing it for later lookups and
+     * saved to the wisdom file for the next runs. FFTW's planner can only be used by one thread at a time, so
+     * measuring is done with a time limit to bound how long it can hold up other lookups.
+     */
+    class PlanCache {
+    public:
+        PlanCache() {}
+
+        ~PlanCache() {
+            if (worker.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lck(queueMtx);
+                    stopWorker = true;
+                }
+                queueCV.notify_all();
+                worker.join();
+            }
+            std::lock_guard<std::mutex> lck(planMtx);
+            for (auto& [key, plan] : plans) { fftwf_destroy_plan(plan); }
+            for (auto& plan : retired) { fftwf_destroy_plan(plan); }
+            plans.clear();
+            retired.clear();
+        }
+
+        // Import the wisdom file if it exists and remember the path for saving
+        bool loadWisdom(const std::string& path) {
+            std::lock_guard<std::mutex> lck(planMtx);
+            wisdomPath = path;
+            return fftwf_import_wisdom_from_filename(path.c_str());
+        }
+
+        bool saveWisdom() {
+            std::lock_guard<std::mutex> lck(planMtx);
+            return exportWisdom();
+        }
+
+        void setMode(PlanMode mode) {
+            _mode = mode;
+        }
+
+        PlanMode getMode() {
+            return _mode;
+        }
+
+        // Complex to complex plan for howmany contiguous transforms of size points
+        fftwf_plan dft(int size, complex_t* in, complex_t* out, int sign, int howmany = 1) {
+            return get({ KIND_DFT, size, howmany, sign, in == out, isAligned(in, out) });
+        }
+
+        // Real to complex plan, out holds size/2 + 1 bins
+        fftwf_plan r2c(int size, float* in, complex_t* out) {
+            return get({ KIND_R2C, size, 1, FFTW_FORWARD, (void*)in == (void*)out, isAligned(in, out) });
+        }
+
+        // Complex to real plan, in holds size/2 + 1 bins
+        fftwf_plan c2r(int size, complex_t* in, float* out) {
+            return get({ KIND_C2R, size, 1, FFTW_BACKWARD, (void*)in == (void*)out, isAligned(in, out) });
+        }
+
+        // Measure forward complex plans of the given sizes in the background, does nothing in estimate mode
+        void warmup(const std::vector<int>& sizes) {
+            if (_mode != PLAN_MODE_MEASURE) { return; }
+            for (int size : sizes) {
+                queueMeasure({ KIND_DFT, size, 1, FFTW_FORWARD, false, true });
+            }
+        }
+
+    private:
+        enum Kind {
+            KIND_DFT,
+            KIND_R2C,
+            KIND_C2R
+        };
+
+        struct Key {
+            Kind kind;
+            int size;
+            int howmany;
+            int sign;
+            bool inPlace;
+            bool aligned;
+
+            bool operator<(const Key& b) const {
+                return std::tie(kind, size, howmany, sign, inPlace, aligned) < std::tie(b.kind, b.size, b.howmany, b.sign, b.inPlace, b.aligned);
+            }
+        };
+
+        static bool isAligned(void* in, void* out) {
+            return !fftwf_alignment_of((float*)in) && !fftwf_alignment_of((float*)out);
+        }
+
+        fftwf_plan get(const Key& key) {
+            {
+                std::lock_guard<std::mutex> lck(cacheMtx);
+                auto it = plans.find(key);
+                if (it != plans.end()) { return it->second; }
+            }
+
+            // FFTW's planner isn't thread safe, every planner call goes through planMtx
+            std::lock_guard<std::mutex> lck(planMtx);
+            {
+                // Someone else may have made the plan while waiting
+                std::lock_guard<std::mutex> lck2(cacheMtx);
+                auto it = plans.find(key);
+                if (it != plans.end()) { return it->second; }
+            }
+
+            fftwf_plan plan = NULL;
+            bool measureLater = false;
+            if (_mode == PLAN_MODE_MEASURE) {
+                plan = makePlan(key, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+                measureLater = !plan;
+            }
+            if (!plan) { plan = makePlan(key, FFTW_ESTIMATE); }
+            if (!plan) {
+                throw std::runtime_error("[PlanCache] Could not create FFT plan");
+            }
+
+            {
+                std::lock_guard<std::mutex> lck2(cacheMtx);
+                plans[key] = plan;
+            }
+            if (measureLater) { queueMeasure(key); }
+            return plan;
+        }
+
+        // Must be called with planMtx held. Plans on scratch buffers so that measuring doesn't overwrite the caller's data
+        fftwf_plan makePlan(const Key& key, unsigned int flags) {
+            if (!key.aligned) { flags |= FFTW_UNALIGNED; }
+            int n = key.size;
+            int bins = (key.kind == KIND_DFT) ? n : (n / 2) + 1;
+            int total = bins * key.howmany;
+            fftwf_complex* in = fftwf_alloc_complex(total);
+            fftwf_complex* out = key.inPlace ? in : fftwf_alloc_complex(total);
+
+            fftwf_plan plan = NULL;
+            if (key.kind == KIND_DFT) {
+                plan = fftwf_plan_many_dft(1, &n, key.howmany, in, NULL, 1, n, out, NULL, 1, n, key.sign, flags);
+            }
+            else if (key.kind == KIND_R2C) {
+                plan = fftwf_plan_dft_r2c_1d(n, (float*)in, out, flags);
+            }
+            else {
+                plan = fftwf_plan_dft_c2r_1d(n, in, (float*)out, flags);
+            }
+
+            fftwf_free(in);
+            if (!key.inPlace) { fftwf_free(out); }
+            return plan;
+        }
+
+        // Must be called with planMtx held
+        bool exportWisdom() {
+            if (wisdomPath.empty()) { return false; }
+            return fftwf_export_wisdom_to_filename(wisdomPath.c_str());
+        }
+
+        void queueMeasure(const Key& key) {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                measureQueue.push_back(key);
+                if (!worker.joinable()) { worker = std::thread(&PlanCache::workerLoop, this); }
+            }
+            queueCV.notify_one();
+        }
+
+        void workerLoop() {
+            while (true) {
+                Key key;
+                {
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    queueCV.wait(lck, [this]() { return !measureQueue.empty() || stopWorker; });
+                    if (stopWorker) { return; }
+                    key = measureQueue.front();
+                    measureQueue.pop_front();
+                }
+
+                fftwf_plan plan = measure(key);
+                if (!plan) { continue; }
+
+                // Plans that were handed out may still be in use, keep them around until the cache goes away
+                {
+                    std::lock_guard<std::mutex> lck2(cacheMtx);
+                    auto it = plans.find(key);
+                    if (it != plans.end()) { retired.push_back(it->second); }
+                    plans[key] = plan;
+                }
+            }
+        }
+
+        fftwf_plan measure(const Key& key) {
+            std::lock_guard<std::mutex> lck(planMtx);
+            fftwf_set_timelimit(PLAN_CACHE_MEASURE_TIMELIMIT);
+            fftwf_plan plan = makePlan(key, FFTW_MEASURE);
+            fftwf_set_timelimit(FFTW_NO_TIMELIMIT);
+            if (plan) { exportWisdom(); }
+            return plan;
+        }
+
+        PlanMode _mode = PLAN_MODE_ESTIMATE;
+        std::string wisdomPath;
+
+        std::mutex planMtx;
+        std::mutex cacheMtx;
+        std::map<Key, fftwf_plan> plans;
+        std::vector<fftwf_plan> retired;
+
+        std::mutex queueMtx;
+        std::condition_variable queueCV;
+        std::deque<Key> measureQueue;
+        std::thread worker;
+        bool stopWorker = false;
+    };
+
+    // Shared by the core and every module
+    SDRPP_EXPORT PlanCache planCache;
+}
@@ -10,6 +10,12 @@ namespace dsp::filter {
 
         DecimatingFIR(stream<D>* in, tap<T>& taps, int decimation) { init(in, taps, decimation); }
 
+        ~DecimatingFIR() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(fullRate);
+        }
+
         void init(stream<D>* in, tap<T>& taps, int decimation) {
             _decimation = decimation;
             base_type::init(in, taps);
@@ -30,6 +36,7 @@ namespace dsp::filter {
             base_type::tempStop();
             _decimation = decimation;
             offset = 0;
+            base_type::updateEngine();
             base_type::tempStart();
         }
 
@@ -44,19 +51,30 @@ namespace dsp::filter {
 
         inline int process(int count, const D* in, D* out) {
             // Copy data to work buffer
+            base_type::reserveBuffer(count);
             memcpy(base_type::bufStart, in, count * sizeof(D));
 
             // Do convolution
             int outCount = 0;
-            for (; offset < count; offset += _decimation) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+            if (base_type::fastConv) {
+                // Filter at full rate in one go and keep only the samples we need
+                buffer::grow(fullRate, fullRateSize, count);
+                base_type::overlapSave.process(count, base_type::buffer, fullRate);
+                for (; offset < count; offset += _decimation) {
+                    out[outCount++] = fullRate[offset];
                 }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
+            }
+            else {
+                for (; offset < count; offset += _decimation) {
+                    if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+                        volk_32f_x2_dot_prod_32f(&out[outCount++], &base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+                    }
+                    if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
+                    }
+                    if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+                        volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
+                    }
                 }
             }
             offset -= count;
@@ -82,7 +100,14 @@ namespace dsp::filter {
         }
 
     protected:
+        bool useFastConv(int tapCount) {
+            return (tapCount / _decimation) >= FIR_FFT_MIN_TAPS;
+        }
+
         int _decimation;
         int offset = 0;
+
+        D* fullRate = NULL;
+        int fullRateSize = 0;
     };
 }
\ No newline at end of file
@@ -78,6 +78,8 @@ namespace dsp::filter {
 
         //DEFAULT_PROC_RUN();
 
+        bool canProcessDirect() { return true; }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -87,6 +89,11 @@ namespace dsp::filter {
             return count;
         }
 
+    protected:
+        int directProcess(int count, const T* in, T* out) {
+            return process(count, in, out);
+        }
+
     private:
         void updateAlpha() {
             float dt = 1.0f / _samplerate;
@@ -1,6 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../taps/tap.h"
+#include "overlap_save.h"
 
 namespace dsp::filter {
     template <class D, class T>
@@ -20,11 +21,13 @@ namespace dsp::filter {
         virtual void init(stream<D>* in, tap<T>& taps) {
             _taps = taps;
 
-            // Allocate and clear buffer
-            buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
+            // Allocate and clear buffer, it grows to fit the largest input seen
+            buffer::grow(buffer, bufSize, _taps.size - 1);
             bufStart = &buffer[_taps.size - 1];
             buffer::clear<D>(buffer, _taps.size - 1);
 
+            updateEngine();
+
             base_type::init(in);
         }
 
@@ -36,7 +39,8 @@ namespace dsp::filter {
             int oldTC = _taps.size;
             _taps = taps;
 
-            // Update start of buffer
+            // Make room for the longer history if needed, then update start of buffer
+            buffer::grow(buffer, bufSize, _taps.size - 1, oldTC - 1);
             bufStart = &buffer[_taps.size - 1];
 
             // Move existing data to make transition seemless
@@ -47,6 +51,8 @@ namespace dsp::filter {
                 memmove(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
                 buffer::clear<D>(buffer, _taps.size - oldTC);
             }
+
+            updateEngine();
             
             base_type::tempStart();
         }
@@ -61,19 +67,15 @@ namespace dsp::filter {
 
         inline int process(int count, const D* in, D* out) {
             // Copy data to work buffer
+            reserveBuffer(count);
             memcpy(bufStart, in, count * sizeof(D));
             
             // Do convolution
-            for (int i = 0; i < count; i++) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
-                }
+            if (fastConv) {
+                overlapSave.process(count, buffer, out);
+            }
+            else {
+                directConv(count, out);
             }
 
             // Move unused data
@@ -94,8 +96,48 @@ namespace dsp::filter {
         }
 
     protected:
+        // Fast convolution only pays off for long filters, decimating filters also account for the skipped outputs
+        virtual bool useFastConv(int tapCount) {
+            return tapCount >= FIR_FFT_MIN_TAPS;
+        }
+
+        void updateEngine() {
+            fastConv = OverlapSave<D, T>::supported && useFastConv(_taps.size);
+            if (fastConv) {
+                overlapSave.setTaps(_taps);
+            }
+            else {
+                overlapSave.destroy();
+            }
+        }
+
+        inline void directConv(int count, D* out) {
+            for (int i = 0; i < count; i++) {
+                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+                    volk_32f_x2_dot_prod_32f(&out[i], &buffer[i], _taps.taps, _taps.size);
+                }
+                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], _taps.taps, _taps.size);
+                }
+                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[i], (lv_32fc_t*)&buffer[i], (lv_32fc_t*)_taps.taps, _taps.size);
+                }
+            }
+        }
+
+        // Make sure the delay buffer can hold count new samples after the history
+        inline void reserveBuffer(int count) {
+            if (buffer::grow(buffer, bufSize, count + _taps.size - 1, _taps.size - 1)) {
+                bufStart = &buffer[_taps.size - 1];
+            }
+        }
+
         tap<T> _taps;
-        D* buffer;
+        D* buffer = NULL;
         D* bufStart;
+        int bufSize = 0;
+
+        OverlapSave<D, T> overlapSave;
+        bool fastConv = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include "../types.h"
+#include "../fft/plan_cache.h"
+#include "../taps/tap.h"
+
+// Tap count from which FIR filters switch from direct dot products to FFT convolution
+#define FIR_FFT_MIN_TAPS 128
+
+namespace dsp::filter {
+    // Overlap-save fast convolution. Gives the same output as FIR::process() for the same delay buffer.
+    template <class D, class T>
+    class OverlapSave {
+    public:
+        // Real signals with complex taps aren't supported by the direct form FIR either
+        static constexpr bool supported = !(std::is_same_v<D, float> && std::is_same_v<T, complex_t>);
+
+        OverlapSave() {}
+
+        ~OverlapSave() {
+            destroy();
+        }
+
+        void setTaps(tap<T>& taps) {
+            destroy();
+            tapCount = taps.size;
+
+            // An FFT a few times longer than the filter keeps the overlap small
+            fftSize = 1;
+            while (fftSize < 4 * tapCount) { fftSize <<= 1; }
+            blockSize = fftSize - tapCount + 1;
+            bins = realSignal ? (fftSize / 2) + 1 : fftSize;
+
+            timeIn = (D*)fftwf_malloc(fftSize * sizeof(D));
+            timeOut = (D*)fftwf_malloc(fftSize * sizeof(D));
+            freq = (complex_t*)fftwf_malloc(bins * sizeof(complex_t));
+            response = buffer::alloc<complex_t>(bins);
+
+            if constexpr (realSignal) {
+                forwardPlan = fft::planCache.r2c(fftSize, (float*)timeIn, freq);
+                backwardPlan = fft::planCache.c2r(fftSize, freq, (float*)timeOut);
+            }
+            else {
+                forwardPlan = fft::planCache.dft(fftSize, (complex_t*)timeIn, freq, FFTW_FORWARD);
+                backwardPlan = fft::planCache.dft(fftSize, freq, (complex_t*)timeOut, FFTW_BACKWARD);
+            }
+
+            // FIR::process() correlates with the taps, so convolve with the reversed taps instead.
+            // The 1/N normalisation of the inverse FFT is folded into the response.
+            buffer::clear<D>(timeIn, fftSize);
+            float scale = 1.0f / (float)fftSize;
+            for (int i = 0; i < tapCount; i++) {
+                T tap = taps.taps[tapCount - 1 - i];
+                if constexpr (std::is_same_v<T, float>) {
+                    if constexpr (realSignal) {
+                        timeIn[i] = tap * scale;
+                    }
+                    else {
+                        ((complex_t*)timeIn)[i] = { tap * scale, 0.0f };
+                    }
+                }
+                else {
+                    ((complex_t*)timeIn)[i] = tap * scale;
+                }
+            }
+            forward();
+            memcpy(response, freq, bins * sizeof(complex_t));
+        }
+
+        /**
+         * Filter count samples. buffer must hold the tap history followed by the new samples,
+         * exactly like the FIR delay buffer.
+         */
+        inline int process(int count, const D* buffer, D* out) {
+            for (int i = 0; i < count; i += blockSize) {
+                int outCount = std::min<int>(blockSize, count - i);
+                int inCount = outCount + tapCount - 1;
+
+                // Load the block with its history, zero padding the last partial block
+                memcpy(timeIn, &buffer[i], inCount * sizeof(D));
+                if (inCount < fftSize) { buffer::clear<D>(timeIn, fftSize - inCount, inCount); }
+
+                // Multiply in the frequency domain
+                forward();
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)freq, (lv_32fc_t*)freq, (lv_32fc_t*)response, bins);
+                backward();
+
+                // The first tapCount-1 outputs are corrupted by circular wrap around
+                memcpy(&out[i], &timeOut[tapCount - 1], outCount * sizeof(D));
+            }
+            return count;
+        }
+
+        void destroy() {
+            if (!timeIn) { return; }
+            fftwf_free(timeIn);
+            fftwf_free(timeOut);
+            fftwf_free(freq);
+            buffer::free(response);
+            timeIn = NULL;
+        }
+
+    private:
+        inline void forward() {
+            if constexpr (realSignal) {
+                fftwf_execute_dft_r2c(forwardPlan, (float*)timeIn, (fftwf_complex*)freq);
+            }
+            else {
+                fftwf_execute_dft(forwardPlan, (fftwf_complex*)timeIn, (fftwf_complex*)freq);
+            }
+        }
+
+        inline void backward() {
+            if constexpr (realSignal) {
+                fftwf_execute_dft_c2r(backwardPlan, (fftwf_complex*)freq, (float*)timeOut);
+            }
+            else {
+                fftwf_execute_dft(backwardPlan, (fftwf_complex*)freq, (fftwf_complex*)timeOut);
+            }
+        }
+
+        static constexpr bool realSignal = std::is_same_v<D, float>;
+
+        int tapCount = 0;
+        int fftSize = 0;
+        int blockSize = 0;
+        int bins = 0;
+
+        D* timeIn = NULL;
+        D* timeOut = NULL;
+        complex_t* freq = NULL;
+        complex_t* response = NULL;
+
+        fftwf_plan forwardPlan;
+        fftwf_plan backwardPlan;
+    };
+}
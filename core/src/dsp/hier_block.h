@@ -50,6 +50,14 @@ namespace dsp {
             }
         }
 
+        virtual void setScheduler(sched::Pool* pool) {
+            assert(_block_init);
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            for (auto& block : blocks) {
+                block->setScheduler(pool);
+            }
+        }
+
     private:
         virtual void doStart() {
             for (auto& block : blocks) {
@@ -14,6 +14,8 @@ namespace dsp::math {
             return count;
         }
 
+        bool canProcessDirect() { return true; }
+
         virtual int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -24,5 +26,10 @@ namespace dsp::math {
             if (!base_type::out.swap(count)) { return -1; }
             return count;
         }
+
+    protected:
+        int directProcess(int count, const complex_t* in, complex_t* out) {
+            return process(count, in, out);
+        }
     };
 }
\ No newline at end of file
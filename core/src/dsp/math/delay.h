@@ -19,7 +19,7 @@ namespace dsp::math {
         void init(stream<T>* in, int delay) {
             _delay = delay;
 
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
+            buffer::grow(buffer, bufSize, _delay);
             bufStart = &buffer[_delay];
             buffer::clear(buffer, _delay);
 
@@ -31,6 +31,7 @@ namespace dsp::math {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
             _delay = delay;
+            buffer::grow(buffer, bufSize, _delay);
             bufStart = &buffer[_delay];
             reset();
             base_type::tempStart();
@@ -45,7 +46,10 @@ namespace dsp::math {
         }
 
         inline int process(int count, const T* in, T* out) {
-            // Copy data into delay buffer
+            // Copy data into delay buffer, growing it if the input is larger than anything seen so far
+            if (buffer::grow(buffer, bufSize, count + _delay, _delay)) {
+                bufStart = &buffer[_delay];
+            }
             memcpy(bufStart, in, count * sizeof(T));
 
             // Copy data out of the delay buffer
@@ -70,7 +74,8 @@ namespace dsp::math {
 
     private:
         int _delay;
-        T* buffer;
+        T* buffer = NULL;
         T* bufStart;
+        int bufSize = 0;
     };
 }
\ No newline at end of file
@@ -27,8 +27,8 @@ namespace dsp::multirate {
             // Build filter bank
             phases = buildPolyphaseBank(_interp, _taps);
 
-            // Allocate delay buffer
-            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
+            // Allocate delay buffer, it grows to fit the largest input seen
+            buffer::grow(buffer, bufSize, phases.tapsPerPhase - 1);
             bufStart = &buffer[phases.tapsPerPhase - 1];
             buffer::clear<T>(buffer, phases.tapsPerPhase - 1);
 
@@ -50,6 +50,7 @@ namespace dsp::multirate {
             phases = buildPolyphaseBank(_interp, _taps);
 
             // Reset buffer
+            buffer::grow(buffer, bufSize, phases.tapsPerPhase - 1);
             bufStart = &buffer[phases.tapsPerPhase - 1];
             reset();
 
@@ -70,6 +71,9 @@ namespace dsp::multirate {
             int outCount = 0;
 
             // Copy input to buffer
+            if (buffer::grow(buffer, bufSize, count + phases.tapsPerPhase - 1, phases.tapsPerPhase - 1)) {
+                bufStart = &buffer[phases.tapsPerPhase - 1];
+            }
             memcpy(bufStart, in, count * sizeof(T));
 
             while (offset < count) {
@@ -119,8 +123,9 @@ namespace dsp::multirate {
         PolyphaseBank<float> phases;
         int phase = 0;
         int offset = 0;
-        T* buffer;
+        T* buffer = NULL;
         T* bufStart;
+        int bufSize = 0;
 
     };
 }
\ No newline at end of file
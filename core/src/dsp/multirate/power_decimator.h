@@ -3,6 +3,12 @@
 #include "../taps/from_array.h"
 #include "decim/plans.h"
 
+// Number of input samples pushed through all the stages at once, small enough for the intermediate data to stay in L2 cache
+#define POWER_DECIM_TILE_SIZE 16384
+
+// Minimum number of input samples per segment when a block is split between threads
+#define POWER_DECIM_MIN_SEGMENT 65536
+
 namespace dsp::multirate {
     template<class T>
     class PowerDecimator : public Processor<T, T> {
@@ -42,9 +48,25 @@ namespace dsp::multirate {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            for (auto& fir : decimFirs) {
-                fir->reset();
+            for (auto& lane : lanes) {
+                resetLane(lane);
             }
+            current = 0;
+            inPhase = 0;
+            base_type::tempStart();
+        }
+
+        /**
+         * Split large blocks into segments decimated in parallel on the given pool. Each segment is decimated
+         * by its own copy of the filters, primed with the input preceding it, so the output is identical
+         * to the serial one. Pass NULL to go back to a single thread.
+         */
+        void setWorkerPool(sched::Pool* pool) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            workerPool = pool;
+            reconfigure();
             base_type::tempStart();
         }
 
@@ -54,18 +76,21 @@ namespace dsp::multirate {
                 memcpy(out, in, count * sizeof(T));
                 return count;
             }
-            
-            // Process data through each stage
-            const T* data = in;
-            int last = stageCount - 1;
-            for (int i = 0; i < stageCount; i++) {
-                auto fir = decimFirs[i];
-                count = fir->process(count, data, out);
-                data = out;
+
+            // Use all lanes if the block is large enough, otherwise the current lane does everything
+            int outCount = -1;
+            if (lanes.size() > 1 && in != out && count >= 2 * POWER_DECIM_MIN_SEGMENT) {
+                outCount = parallelProcess(count, in, out);
             }
-            return count;
+            if (outCount < 0) {
+                outCount = tiledProcess(lanes[current], count, in, out);
+            }
+            inPhase = (inPhase + count) % _ratio;
+            return outCount;
         }
 
+        bool canProcessDirect() { return true; }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -81,10 +106,76 @@ namespace dsp::multirate {
         }
 
     protected:
+        int directProcess(int count, const T* in, T* out) {
+            return process(count, in, out);
+        }
+
+        // Copy of all the decimation stages along with its state
+        struct Lane {
+            std::vector<filter::DecimatingFIR<T, float>*> firs;
+            T* tile;
+        };
+
+        inline int tiledProcess(Lane& lane, int count, const T* in, T* out) {
+            // Run each tile through all the stages, only the last one writes to the output
+            int outCount = 0;
+            for (int i = 0; i < count; i += POWER_DECIM_TILE_SIZE) {
+                int tileCount = std::min<int>(POWER_DECIM_TILE_SIZE, count - i);
+                const T* data = &in[i];
+                for (int j = 0; j < stageCount; j++) {
+                    T* stageOut = (j == stageCount - 1) ? &out[outCount] : lane.tile;
+                    tileCount = lane.firs[j]->process(tileCount, data, stageOut);
+                    data = stageOut;
+                }
+                outCount += tileCount;
+            }
+            return outCount;
+        }
+
+        int parallelProcess(int count, const T* in, T* out) {
+            // Output samples are generated on input samples whose index since the last reset is a multiple of the ratio.
+            // Cutting segments there means every stage is at the start of a decimation period at the boundary.
+            int laneCount = std::min<int>(lanes.size(), count / POWER_DECIM_MIN_SEGMENT);
+            int firstOut = (_ratio - inPhase) % _ratio;
+            segStarts.resize(laneCount + 1);
+            segStarts[0] = 0;
+            for (int i = 1; i < laneCount; i++) {
+                int start = (int)(((int64_t)count * i) / laneCount);
+                start += (_ratio - ((inPhase + start) % _ratio)) % _ratio;
+                if (start < warmup || start <= segStarts[i - 1] || start >= count) { return -1; }
+                segStarts[i] = start;
+            }
+            segStarts[laneCount] = count;
+
+            // Number of outputs generated before the given input index
+            auto outputsBefore = [=](int index) { return (index > firstOut) ? ((index - firstOut - 1) / (int)_ratio) + 1 : 0; };
+
+            // The first segment continues from the current state, the others start from scratch slightly earlier
+            workerPool->parallelFor(laneCount, [&](int i) {
+                Lane& lane = lanes[(current + i) % lanes.size()];
+                if (i) {
+                    resetLane(lane);
+                    tiledProcess(lane, warmup, &in[segStarts[i] - warmup], lane.tile);
+                }
+                tiledProcess(lane, segStarts[i + 1] - segStarts[i], &in[segStarts[i]], &out[outputsBefore(segStarts[i])]);
+            });
+
+            // The lane that processed the last segment now holds the state
+            current = (current + laneCount - 1) % lanes.size();
+            return outputsBefore(count);
+        }
+
+        void resetLane(Lane& lane) {
+            for (auto& fir : lane.firs) { fir->reset(); }
+        }
+
         void freeFirs() {
-            for (auto& fir : decimFirs) { delete fir; }
+            for (auto& lane : lanes) {
+                for (auto& fir : lane.firs) { delete fir; }
+                buffer::free(lane.tile);
+            }
             for (auto& taps : decimTaps) { taps::free(taps); }
-            decimFirs.clear();
+            lanes.clear();
             decimTaps.clear();
         }
 
@@ -92,6 +183,9 @@ namespace dsp::multirate {
             // Delete DDC FIRs and taps
             freeFirs();
 
+            current = 0;
+            inPhase = 0;
+
             // Generate filters based on DDC plan
             if (_ratio > 1) {
                 int planId = log2(_ratio) - 1;
@@ -99,10 +193,33 @@ namespace dsp::multirate {
                 stageCount = plan.stageCount;
                 for (int i = 0; i < stageCount; i++) {
                     tap<float> taps = taps::fromArray<float>(plan.stages[i].tapcount, plan.stages[i].taps);
-                    auto fir = new filter::DecimatingFIR<T, float>(NULL, taps, plan.stages[i].decimation);
-                    fir->out.free();
                     decimTaps.push_back(taps);
-                    decimFirs.push_back(fir);
+                }
+
+                // Input needed to fill the history of every stage, rounded up to a whole decimation period
+                warmup = 0;
+                int stageRatio = 1;
+                for (int i = 0; i < stageCount; i++) {
+                    warmup += (plan.stages[i].tapcount - 1) * stageRatio;
+                    stageRatio *= plan.stages[i].decimation;
+                }
+                warmup = ((warmup + _ratio - 1) / _ratio) * _ratio;
+
+                // One lane per worker if running in parallel
+                int laneCount = 1;
+                if (workerPool) {
+                    workerPool->init();
+                    laneCount = std::max<int>(workerPool->getThreadCount(), 1);
+                }
+                for (int l = 0; l < laneCount; l++) {
+                    Lane lane;
+                    for (int i = 0; i < stageCount; i++) {
+                        auto fir = new filter::DecimatingFIR<T, float>(NULL, decimTaps[i], plan.stages[i].decimation);
+                        fir->out.free();
+                        lane.firs.push_back(fir);
+                    }
+                    lane.tile = buffer::alloc<T>(POWER_DECIM_TILE_SIZE);
+                    lanes.push_back(lane);
                 }
             }
         }
@@ -112,9 +229,15 @@ namespace dsp::multirate {
             return ((ratio & (ratio - 1)) == 0) && ratio && ratio <= getMaxRatio();
         }
 
-        std::vector<filter::DecimatingFIR<T, float>*> decimFirs;
+        std::vector<Lane> lanes;
         std::vector<tap<float>> decimTaps;
         unsigned int _ratio;
         int stageCount;
+
+        sched::Pool* workerPool = NULL;
+        int current = 0;
+        int inPhase = 0;
+        int warmup = 0;
+        std::vector<int> segStarts;
     };
 }
\ No newline at end of file
@@ -40,6 +40,7 @@ namespace dsp::multirate {
             reconfigure();
 
             base_type::init(in);
+            base_type::sizeOutput();
         }
 
         void reset() {
@@ -95,9 +96,17 @@ namespace dsp::multirate {
             return count;
         }
 
+        bool canProcessDirect() { return true; }
+
+        // When decimating, the output also holds the pre-decimated samples which are never more than the input
+        int maxOutputCount(int count) {
+            return ceil((double)count * std::max<double>(_outSamplerate / _inSamplerate, 1.0)) + 1;
+        }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
+            if (!base_type::reserveOutput(maxOutputCount(count))) { return -1; }
 
             int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
 
@@ -110,6 +119,10 @@ namespace dsp::multirate {
         }
 
     protected:
+        int directProcess(int count, const T* in, T* out) {
+            return process(count, in, out);
+        }
+
         enum Mode {
             BOTH,
             DECIM_ONLY,
@@ -1,7 +1,7 @@
 #pragma once
 #include "../processor.h"
 #include "../window/nuttall.h"
-#include <fftw3.h>
+#include "../fft/plan_cache.h"
 
 namespace dsp::noise_reduction {
     class FMIF : public Processor<complex_t, complex_t> {
@@ -44,6 +44,9 @@ namespace dsp::noise_reduction {
 
         int process(int count, const complex_t* in, complex_t* out) {
             // Write new input data to buffer buffer
+            if (buffer::grow(buffer, bufSize, count + _bins - 1, _bins - 1)) {
+                bufferStart = &buffer[_bins - 1];
+            }
             memcpy(bufferStart, in, count * sizeof(complex_t));
             
             // Iterate the FFT
@@ -52,7 +55,7 @@ namespace dsp::noise_reduction {
                 volk_32fc_32f_multiply_32fc((lv_32fc_t*)forwFFTIn, (lv_32fc_t*)&buffer[i], fftWin, _bins);
 
                 // Do forward FFT
-                fftwf_execute(forwardPlan);
+                fftwf_execute_dft(forwardPlan, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut);
 
                 // Process bins here
                 uint32_t idx;
@@ -63,7 +66,7 @@ namespace dsp::noise_reduction {
                 backFFTIn[idx] = forwFFTOut[idx];
 
                 // Do reverse FFT and get first element
-                fftwf_execute(backwardPlan);
+                fftwf_execute_dft(backwardPlan, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut);
                 out[i] = backFFTOut[_bins / 2];
 
                 // Reset the input buffer
@@ -76,6 +79,8 @@ namespace dsp::noise_reduction {
             return count;
         }
 
+        bool canProcessDirect() { return true; }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -89,6 +94,10 @@ namespace dsp::noise_reduction {
         }
 
     protected:
+        int directProcess(int count, const complex_t* in, complex_t* out) {
+            return process(count, in, out);
+        }
+
         void initBuffers() {
             // Allocate FFT buffers
             forwFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
@@ -96,8 +105,8 @@ namespace dsp::noise_reduction {
             backFFTIn = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
             backFFTOut = (complex_t*)fftwf_malloc(_bins * sizeof(complex_t));
 
-            // Allocate and clear delay buffer
-            buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + 64000);
+            // Allocate and clear delay buffer, it grows to fit the largest input seen
+            buffer::grow(buffer, bufSize, _bins - 1);
             bufferStart = &buffer[_bins - 1];
             buffer::clear(buffer, _bins - 1);
 
@@ -112,18 +121,18 @@ namespace dsp::noise_reduction {
             for (int i = 0; i < _bins; i++) { fftWin[i] = window::nuttall(i, _bins - 1); }
 
             // Plan FFTs
-            forwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)forwFFTIn, (fftwf_complex*)forwFFTOut, FFTW_FORWARD, FFTW_ESTIMATE);
-            backwardPlan = fftwf_plan_dft_1d(_bins, (fftwf_complex*)backFFTIn, (fftwf_complex*)backFFTOut, FFTW_BACKWARD, FFTW_ESTIMATE);
+            forwardPlan = fft::planCache.dft(_bins, forwFFTIn, forwFFTOut, FFTW_FORWARD);
+            backwardPlan = fft::planCache.dft(_bins, backFFTIn, backFFTOut, FFTW_BACKWARD);
         }
 
         void destroyBuffers() {
-            fftwf_destroy_plan(forwardPlan);
-            fftwf_destroy_plan(backwardPlan);
             fftwf_free(forwFFTIn);
             fftwf_free(forwFFTOut);
             fftwf_free(backFFTIn);
             fftwf_free(backFFTOut);
             buffer::free(buffer);
+            buffer = NULL;
+            bufSize = 0;
             buffer::free(ampBuf);
             buffer::free(fftWin);
         }
@@ -136,8 +145,9 @@ namespace dsp::noise_reduction {
         fftwf_plan forwardPlan;
         fftwf_plan backwardPlan;
 
-        complex_t* buffer;
+        complex_t* buffer = NULL;
         complex_t* bufferStart;
+        int bufSize = 0;
 
         float* fftWin;
 
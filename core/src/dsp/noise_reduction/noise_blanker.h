@@ -56,6 +56,8 @@ namespace dsp::noise_reduction {
             return count;
         }
 
+        bool canProcessDirect() { return true; }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -68,6 +70,10 @@ namespace dsp::noise_reduction {
         }
 
     protected:
+        int directProcess(int count, const complex_t* in, complex_t* out) {
+            return process(count, (complex_t*)in, out);
+        }
+
         float _rate;
         float _invRate;
         float _level;
@@ -19,8 +19,6 @@ namespace dsp::noise_reduction {
         void init(stream<complex_t>* in, double level) {
             _level = level;
 
-            normBuffer = buffer::alloc<float>(STREAM_BUFFER_SIZE);
-
             base_type::init(in);
         }
 
@@ -32,6 +30,7 @@ namespace dsp::noise_reduction {
 
         inline int process(int count, const complex_t* in, complex_t* out) {
             float sum;
+            buffer::grow(normBuffer, normBufferSize, count);
             volk_32fc_magnitude_32f(normBuffer, (lv_32fc_t*)in, count);
             volk_32f_accumulator_s32f(&sum, normBuffer, count);
             sum /= (float)count;
@@ -48,6 +47,8 @@ namespace dsp::noise_reduction {
 
         //DEFAULT_PROC_RUN();
 
+        bool canProcessDirect() { return true; }
+
         int run() {
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
@@ -57,8 +58,14 @@ namespace dsp::noise_reduction {
             return count;
         }
 
+    protected:
+        int directProcess(int count, const complex_t* in, complex_t* out) {
+            return process(count, in, out);
+        }
+
     private:
-        float* normBuffer;
+        float* normBuffer = NULL;
+        int normBufferSize = 0;
         float _level = -50.0f;
                 
     };
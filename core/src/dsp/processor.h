@@ -66,9 +66,46 @@ namespace dsp {
 
         virtual int run() = 0;
 
+        // Direct processing, used by fused chains to run the block without its worker thread
+        virtual bool canProcessDirect() { return false; }
+
+        // Upper bound on the number of samples written to the output when processing count input samples
+        virtual int maxOutputCount(int count) { return count; }
+
+        int processDirect(int count, const I* in, O* out) {
+            // Hold the control mutex so that parameter changes can't race with processing
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            return directProcess(count, in, out);
+        }
+
+        // Output bound for direct processing, which like processDirect() can't race with parameter changes
+        int maxDirectOutputCount(int count) {
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            return maxOutputCount(count);
+        }
+
         stream<O> out;
 
     protected:
+        virtual int directProcess(int count, const I* in, O* out) { return -1; }
+
+        /**
+         * Size the output for what a full input buffer produces instead of STREAM_BUFFER_SIZE. Blocks without an
+         * input keep the default size since their output may be used as a work buffer by the block that owns them.
+         * Must be called at the end of init(), and run() must then reserve the output before writing to it.
+         */
+        void sizeOutput() {
+            if (!_in) { return; }
+            out.setBufferSize(std::max<int>(maxOutputCount(_in->getBufferSize()), STREAM_MIN_BUFFER_SIZE));
+        }
+
+        // Make sure the output can hold count samples. If stopped while waiting, the input is flushed and false is returned.
+        inline bool reserveOutput(int count) {
+            if (out.reserve(count)) { return true; }
+            _in->flush();
+            return false;
+        }
+
         stream<I>* _in;
     };
 }
@@ -40,13 +40,52 @@ namespace dsp::routing {
             base_type::tempStop();
             streams.erase(sit);
             base_type::unregisterOutput(stream);
+
+            // The stream won't be read anymore, so it mustn't hold on to the broadcast buffer
+            stream->releaseShared();
+
+            base_type::tempStart();
+        }
+
+        /**
+         * In broadcast mode, every bound stream receives the input buffer itself instead of a copy.
+         * The input is only flushed once every reader has flushed its stream, so readers must not
+         * modify their input buffer.
+         */
+        void setBroadcast(bool enabled) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            broadcast = enabled;
             base_type::tempStart();
         }
 
         int run() {
+            // Give the previous broadcast buffer back to its writer once all readers are done with it
+            if (pendingIn) {
+                if (!bcastRef.wait()) { return -1; }
+                pendingIn->flush();
+                pendingIn = NULL;
+            }
+
             int count = base_type::_in->read();
             if (count < 0) { return -1; }
 
+            if (broadcast) {
+                // Lend the same input buffer to every stream
+                int streamCount = streams.size();
+                bcastRef.acquire(streamCount);
+                pendingIn = base_type::_in;
+                for (int i = 0; i < streamCount; i++) {
+                    if (!streams[i]->swapShared(base_type::_in->readBuf, count, &bcastRef)) {
+                        // The streams that didn't get the buffer won't release it
+                        for (int j = i; j < streamCount; j++) { bcastRef.release(); }
+                        return -1;
+                    }
+                }
+                return count;
+            }
+
             for (const auto& stream : streams) {
                 memcpy(stream->writeBuf, base_type::_in->readBuf, count * sizeof(T));
                 if (!stream->swap(count)) {
@@ -61,7 +100,54 @@ namespace dsp::routing {
         }
 
     protected:
+        class BroadcastRef : public shared_buffer_ref {
+        public:
+            void acquire(int count) {
+                refs = count;
+            }
+
+            void release() {
+                if (--refs) { return; }
+                { std::lock_guard<std::mutex> lck(mtx); }
+                cv.notify_all();
+            }
+
+            // Returns false if the wait was aborted by stop()
+            bool wait() {
+                std::unique_lock<std::mutex> lck(mtx);
+                cv.wait(lck, [this]() { return refs.load() <= 0 || stopped; });
+                return !stopped;
+            }
+
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    stopped = true;
+                }
+                cv.notify_all();
+            }
+
+            void clearStop() {
+                stopped = false;
+            }
+
+        private:
+            std::atomic<int> refs = 0;
+            std::mutex mtx;
+            std::condition_variable cv;
+            bool stopped = false;
+        };
+
+        void doStop() {
+            bcastRef.stop();
+            base_type::doStop();
+            bcastRef.clearStop();
+        }
+
         std::vector<stream<T>*> streams;
+        bool broadcast = false;
+        BroadcastRef bcastRef;
+        stream<T>* pendingIn = NULL;
 
     };
 }
\ No newline at end of file
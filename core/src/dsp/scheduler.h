@@ -0,0 +1,314 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include "stream.h"
+
+// Maximum number of times a task runs back-to-back before giving its worker back to the pool
+#define SCHED_MAX_TASK_BATCH 16
+
+namespace dsp::sched {
+    class Pool;
+
+    // Unit of work run by the pool whenever one of the streams it observes changes state
+    class Task : public stream_observer {
+        friend Pool;
+    public:
+        virtual ~Task() {}
+
+        // Returns true if step() can be called without blocking
+        virtual bool ready() = 0;
+
+        // Do one iteration of work, returns false once the task was stopped
+        virtual bool step() = 0;
+
+        void streamReady();
+
+        void enable(Pool* pool);
+        void disable();
+
+    private:
+        enum State {
+            IDLE,
+            QUEUED,
+            RUNNING,
+            RUNNING_RESCHEDULED
+        };
+
+        Pool* _pool = NULL;
+        std::atomic<bool> enabled = false;
+        std::atomic<int> state = IDLE;
+    };
+
+    // Fixed size thread pool with one deque per worker and work stealing
+    class Pool {
+    public:
+        Pool() {}
+
+        Pool(int threads) { init(threads); }
+
+        ~Pool() {
+            if (!_init) { return; }
+            {
+                std::lock_guard<std::mutex> lck(sleepMtx);
+                stopWorkers = true;
+            }
+            sleepCV.notify_all();
+            for (auto& w : workers) {
+                if (w->thread.joinable()) { w->thread.join(); }
+                delete w;
+            }
+            workers.clear();
+            _init = false;
+        }
+
+        // Start the worker threads, defaults to one per core
+        void init(int threads = 0) {
+            std::lock_guard<std::mutex> lck(initMtx);
+            if (_init) { return; }
+            if (threads <= 0) { threads = std::max<int>(std::thread::hardware_concurrency(), 1); }
+            for (int i = 0; i < threads; i++) { workers.push_back(new Worker); }
+            for (int i = 0; i < threads; i++) { workers[i]->thread = std::thread(&Pool::workerLoop, this, i); }
+            _init = true;
+        }
+
+        int getThreadCount() {
+            return workers.size();
+        }
+
+        /**
+         * Call func(i) for every i in [0, count) using the pool's workers and wait for all calls to
+         * return. The calling thread also takes part, so it's safe to call from a pool worker. Helpers
+         * that didn't get a worker by the time all calls returned are taken back out of the queues.
+         */
+        template <typename Func>
+        void parallelFor(int count, Func func) {
+            init();
+
+            // Every helper and the caller pull indices until there are none left
+            std::atomic<int> next = 0;
+            std::atomic<int> done = 0;
+            std::mutex doneMtx;
+            std::condition_variable doneCV;
+            auto work = [&]() {
+                for (int i = next++; i < count; i = next++) {
+                    func(i);
+                    if (++done == count) {
+                        std::lock_guard<std::mutex> lck(doneMtx);
+                        doneCV.notify_all();
+                    }
+                }
+            };
+
+            // Wake up to one helper per worker, no need for more than there are indices
+            int helperCount = std::min<int>(workers.size(), count - 1);
+            std::deque<FuncTask<decltype(work)>> helpers;
+            for (int i = 0; i < helperCount; i++) {
+                helpers.emplace_back(work);
+                helpers[i]._pool = this;
+                helpers[i].enabled = true;
+                schedule(&helpers[i]);
+            }
+            work();
+
+            // Every index is taken at this point, only wait for the calls still running on other threads
+            {
+                std::unique_lock<std::mutex> lck(doneMtx);
+                doneCV.wait(lck, [&]() { return done.load() == count; });
+            }
+
+            // Helpers still queued have nothing left to do, the others were already popped by a worker
+            // and return as soon as they see there are no indices left
+            for (auto& h : helpers) { cancel(&h); }
+            std::unique_lock<std::mutex> lck(idleMtx);
+            idleWaiters++;
+            idleCV.wait(lck, [&]() {
+                for (auto& h : helpers) {
+                    if (h.state.load() != Task::IDLE) { return false; }
+                }
+                return true;
+            });
+            idleWaiters--;
+        }
+
+        void schedule(Task* task) {
+            // Only queue the task if it isn't already queued, if it's running, tell the worker to run it again
+            int st = task->state.load();
+            while (true) {
+                if (st == Task::IDLE) {
+                    if (task->state.compare_exchange_weak(st, Task::QUEUED)) { break; }
+                }
+                else if (st == Task::RUNNING) {
+                    if (task->state.compare_exchange_weak(st, Task::RUNNING_RESCHEDULED)) { return; }
+                }
+                else {
+                    return;
+                }
+            }
+            push(task);
+        }
+
+    private:
+        // Task that runs a function once every time it's scheduled
+        template <typename Func>
+        class FuncTask : public Task {
+        public:
+            FuncTask(Func& func) : _func(func) {}
+            bool ready() { return true; }
+            bool step() {
+                _func();
+                return false;
+            }
+
+        private:
+            Func& _func;
+        };
+
+        struct Worker {
+            std::mutex mtx;
+            std::deque<Task*> tasks;
+            std::thread thread;
+        };
+
+        void push(Task* task) {
+            // Tasks scheduled from a worker go to its own deque to stay on the same core, others are distributed
+            int id = (currentPool == this) ? currentWorker : (nextWorker++ % workers.size());
+            {
+                std::lock_guard<std::mutex> lck(workers[id]->mtx);
+                workers[id]->tasks.push_back(task);
+            }
+            pending++;
+            if (sleeping.load()) {
+                { std::lock_guard<std::mutex> lck(sleepMtx); }
+                sleepCV.notify_one();
+            }
+        }
+
+        // Take a task back out of the queue it's waiting in, returns false if a worker already popped it
+        bool cancel(Task* task) {
+            for (auto& w : workers) {
+                std::lock_guard<std::mutex> lck(w->mtx);
+                auto it = std::find(w->tasks.begin(), w->tasks.end(), task);
+                if (it == w->tasks.end()) { continue; }
+                w->tasks.erase(it);
+                pending--;
+                task->state.store(Task::IDLE);
+                return true;
+            }
+            return false;
+        }
+
+        Task* pop(int id) {
+            // Newest task from our own deque first
+            Worker* self = workers[id];
+            {
+                std::lock_guard<std::mutex> lck(self->mtx);
+                if (!self->tasks.empty()) {
+                    Task* task = self->tasks.back();
+                    self->tasks.pop_back();
+                    return task;
+                }
+            }
+
+            // Otherwise, steal the oldest task from another worker
+            int count = workers.size();
+            for (int i = 1; i < count; i++) {
+                Worker* victim = workers[(id + i) % count];
+                std::lock_guard<std::mutex> lck(victim->mtx);
+                if (!victim->tasks.empty()) {
+                    Task* task = victim->tasks.front();
+                    victim->tasks.pop_front();
+                    return task;
+                }
+            }
+            return NULL;
+        }
+
+        void execute(Task* task) {
+            task->state.store(Task::RUNNING);
+
+            bool again = false;
+            for (int i = 0; i < SCHED_MAX_TASK_BATCH; i++) {
+                if (!task->enabled || !task->ready()) { break; }
+                if (!task->step()) { break; }
+                again = (i == SCHED_MAX_TASK_BATCH - 1);
+            }
+
+            // Requeue if the batch limit was hit or if a stream changed state while running
+            int st = Task::RUNNING;
+            if (!again && task->state.compare_exchange_strong(st, Task::IDLE)) {
+                // The task may be gone once idle, only the pool is touched from here
+                if (idleWaiters.load()) {
+                    { std::lock_guard<std::mutex> lck(idleMtx); }
+                    idleCV.notify_all();
+                }
+                return;
+            }
+            task->state.store(Task::QUEUED);
+            push(task);
+        }
+
+        void workerLoop(int id) {
+            currentPool = this;
+            currentWorker = id;
+            while (true) {
+                Task* task = pop(id);
+                if (task) {
+                    pending--;
+                    execute(task);
+                    continue;
+                }
+
+                // Nothing to do, sleep until a task gets pushed
+                std::unique_lock<std::mutex> lck(sleepMtx);
+                sleeping++;
+                sleepCV.wait(lck, [this]() { return pending.load() > 0 || stopWorkers; });
+                sleeping--;
+                if (stopWorkers) { break; }
+            }
+        }
+
+        static inline thread_local Pool* currentPool = NULL;
+        static inline thread_local int currentWorker = 0;
+
+        std::vector<Worker*> workers;
+        std::atomic<unsigned int> nextWorker = 0;
+        std::atomic<int> pending = 0;
+
+        std::mutex sleepMtx;
+        std::condition_variable sleepCV;
+        std::atomic<int> sleeping = 0;
+        bool stopWorkers = false;
+
+        std::mutex idleMtx;
+        std::condition_variable idleCV;
+        std::atomic<int> idleWaiters = 0;
+
+        std::mutex initMtx;
+        bool _init = false;
+    };
+
+    inline void Task::streamReady() {
+        if (!enabled) { return; }
+        _pool->schedule(this);
+    }
+
+    inline void Task::enable(Pool* pool) {
+        _pool = pool;
+        _pool->init();
+        enabled = true;
+        _pool->schedule(this);
+    }
+
+    inline void Task::disable() {
+        // Prevent new runs and wait for any queued or running one to finish
+        enabled = false;
+        while (state.load() != IDLE) {
+            std::this_thread::yield();
+        }
+    }
+}
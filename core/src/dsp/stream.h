@@ -1,14 +1,55 @@
 #pragma once
 #include <string.h>
+#include <math.h>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
 #include <volk/volk.h>
 #include "buffer/buffer.h"
 
-// 1MSample buffer
+// 1MSample buffer, default size of a stream and upper bound of rate-derived sizes
 #define STREAM_BUFFER_SIZE 1000000
 
+// Lower bound of rate-derived stream sizes
+#define STREAM_MIN_BUFFER_SIZE 1024
+
+// Amount of signal a rate-derived stream buffer holds, in seconds
+#define STREAM_TARGET_LATENCY 0.02
+
+// Number of times a ring stream polls before parking the thread
+#define STREAM_RING_SPIN_COUNT 2048
+
 namespace dsp {
+    enum StreamWaitPolicy {
+        STREAM_WAIT_BLOCK,  // Park on a condition variable as soon as the ring is empty/full
+        STREAM_WAIT_SPIN    // Spin for STREAM_RING_SPIN_COUNT polls before parking
+    };
+
+    // Notified by a stream when it becomes readable (reader side) or writable (writer side)
+    class stream_observer {
+    public:
+        virtual ~stream_observer() {}
+        virtual void streamReady() = 0;
+    };
+
+    // Handle on a buffer shared by several streams, released once by each reader when it's done with it
+    class shared_buffer_ref {
+    public:
+        virtual ~shared_buffer_ref() {}
+        virtual void release() = 0;
+    };
+
+    // Buffer size needed to hold a given amount of signal at a given samplerate
+    inline int streamBufferSizeFor(double samplerate, double latency = STREAM_TARGET_LATENCY) {
+        double size = ceil(samplerate * latency);
+        if (size < STREAM_MIN_BUFFER_SIZE) { return STREAM_MIN_BUFFER_SIZE; }
+        if (size > STREAM_BUFFER_SIZE) { return STREAM_BUFFER_SIZE; }
+        return size;
+    }
+
     class untyped_stream {
     public:
         virtual ~untyped_stream() {}
@@ -19,14 +60,18 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+        virtual bool isReadable() { return true; }
+        virtual bool isWritable() { return true; }
+        virtual void setReaderObserver(stream_observer* observer) {}
+        virtual void setWriterObserver(stream_observer* observer) {}
+        virtual void releaseShared() {}
     };
 
     template <class T>
     class stream : public untyped_stream {
     public:
         stream() {
-            writeBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-            readBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+            allocBuffers();
         }
 
         virtual ~stream() {
@@ -34,13 +79,75 @@ namespace dsp {
         }
 
         virtual void setBufferSize(int samples) {
+            free();
+            bufferSize = samples;
+            allocBuffers();
+        }
+
+        int getBufferSize() {
+            return bufferSize;
+        }
+
+        /**
+         * Make sure writeBuf can hold at least the given number of samples, growing the buffers if needed.
+         * Must only be called by the writer, before it starts filling writeBuf. Growing waits for the reader
+         * to give back all its buffers. Returns false if the writer was stopped while waiting.
+         */
+        inline bool reserve(int samples) {
+            if (samples <= bufferSize) { return true; }
+
+            // Grow by at least 50% so that slowly increasing block sizes don't reallocate every time
+            int newSize = std::max<int>(samples, bufferSize + (bufferSize / 2));
+
+            if (ringSlots) {
+                // Wait for the reader to release every slot
+                uint64_t head = ringHead.load();
+                if (!ringWait(swapMtx, swapCV, writerParked, writerStop, [this, head]() { return ringTail.load() == head; })) {
+                    return false;
+                }
+                for (auto& buf : ringBufs) {
+                    buffer::free(buf);
+                    buf = buffer::alloc<T>(newSize);
+                }
+                buffer::free(ringSpare);
+                ringSpare = buffer::alloc<T>(newSize);
+                spareInUse = false;
+                writeBuf = ringBufs[head % ringSlots];
+                bufferSize = newSize;
+                return true;
+            }
+
+            // Wait for the reader to flush, it then doesn't hold any of our buffers
+            std::unique_lock<std::mutex> lck(swapMtx);
+            swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+            if (writerStop) { return false; }
             buffer::free(writeBuf);
             buffer::free(readBuf);
-            writeBuf = buffer::alloc<T>(samples);
-            readBuf = buffer::alloc<T>(samples);
+            writeBuf = buffer::alloc<T>(newSize);
+            readBuf = buffer::alloc<T>(newSize);
+            bufferSize = newSize;
+            return true;
+        }
+
+        /**
+         * Switch the stream to a lock-free single-producer/single-consumer ring of buffers.
+         * The writer can then run up to (slots - 1) buffers ahead of the reader.
+         * The read()/flush()/swap() contract is unchanged. Passing less than 2 slots restores
+         * the default double-buffer transport. Must not be called while the stream is in use.
+         */
+        void setRingMode(int slots, StreamWaitPolicy policy = STREAM_WAIT_SPIN) {
+            free();
+            ringSlots = (slots >= 2) ? slots : 0;
+            waitPolicy = policy;
+            allocBuffers();
+        }
+
+        int getRingSlots() {
+            return ringSlots;
         }
 
         virtual inline bool swap(int size) {
+            if (ringSlots) { return ringSwap(size); }
             {
                 // Wait to either swap or stop
                 std::unique_lock<std::mutex> lck(swapMtx);
@@ -63,11 +170,47 @@ namespace dsp {
                 dataReady = true;
             }
             rdyCV.notify_all();
+            notifyObserver(readerObserver);
+
+            return true;
+        }
+
+        /**
+         * Publish a read-only buffer owned by someone else instead of writeBuf. The reader sees it as readBuf
+         * and ref->release() is called once the reader flushes it. Blocks the same way swap() does.
+         */
+        virtual inline bool swapShared(const T* data, int size, shared_buffer_ref* ref) {
+            if (ringSlots) { return ringSwap(size, data, ref); }
+            {
+                // Wait to either swap or stop
+                std::unique_lock<std::mutex> lck(swapMtx);
+                swapCV.wait(lck, [this] { return (canSwap || writerStop); });
+
+                // If writer was stopped, abandon operation
+                if (writerStop) { return false; }
+
+                // Lend the shared buffer to the reader, our own buffer is given back on flush
+                dataSize = size;
+                ownedReadBuf = readBuf;
+                readBuf = (T*)data;
+                canSwap = false;
+            }
+
+            // Notify reader that some data is ready
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                sharedRef = ref;
+                dataReady = true;
+            }
+            rdyCV.notify_all();
+            notifyObserver(readerObserver);
 
             return true;
         }
 
         virtual inline int read() {
+            if (ringSlots) { return ringRead(); }
+
             // Wait for data to be ready or to be stopped
             std::unique_lock<std::mutex> lck(rdyMtx);
             rdyCV.wait(lck, [this] { return (dataReady || readerStop); });
@@ -76,10 +219,19 @@ namespace dsp {
         }
 
         virtual inline void flush() {
-            // Clear data ready
+            if (ringSlots) {
+                ringFlush();
+                return;
+            }
+
+            // Clear data ready and take back our own buffer if a shared one was lent
+            shared_buffer_ref* ref;
             {
                 std::lock_guard<std::mutex> lck(rdyMtx);
                 dataReady = false;
+                ref = sharedRef;
+                sharedRef = NULL;
+                if (ref) { readBuf = ownedReadBuf; }
             }
 
             // Notify writer that buffers can be swapped
@@ -89,6 +241,35 @@ namespace dsp {
             }
 
             swapCV.notify_all();
+            notifyObserver(writerObserver);
+
+            // Notify the owner of the shared buffer that we're done with it
+            if (ref) { ref->release(); }
+        }
+
+        // Give back any shared buffer still held by the stream. Only to be used when the reader won't flush anymore.
+        virtual void releaseShared() {
+            if (ringSlots) {
+                uint64_t head = ringHead.load();
+                for (uint64_t i = ringTail.load(); i != head; i++) {
+                    shared_buffer_ref* ref = ringRefs[i % ringSlots];
+                    ringRefs[i % ringSlots] = NULL;
+                    ringShared[i % ringSlots] = NULL;
+                    if (ref) { ref->release(); }
+                }
+                readPending = false;
+                ringTail.store(head);
+                if (writerParked.load()) {
+                    { std::lock_guard<std::mutex> lck(swapMtx); }
+                    swapCV.notify_all();
+                }
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lck(rdyMtx);
+                if (!sharedRef) { return; }
+            }
+            flush();
         }
 
         virtual void stopWriter() {
@@ -115,17 +296,168 @@ namespace dsp {
             readerStop = false;
         }
 
+        // Non-blocking checks used by the scheduler: true if read() or swap() wouldn't block
+        virtual bool isReadable() {
+            if (ringSlots) {
+                return readPending || (ringHead.load() != ringTail.load()) || readerStop;
+            }
+            std::lock_guard<std::mutex> lck(rdyMtx);
+            return dataReady || readerStop;
+        }
+
+        virtual bool isWritable() {
+            if (ringSlots) {
+                return (ringHead.load() + 1 - ringTail.load() < (uint64_t)ringSlots) || writerStop;
+            }
+            std::lock_guard<std::mutex> lck(swapMtx);
+            return canSwap || writerStop;
+        }
+
+        virtual void setReaderObserver(stream_observer* observer) {
+            std::lock_guard<std::mutex> lck(observerMtx);
+            readerObserver = observer;
+        }
+
+        virtual void setWriterObserver(stream_observer* observer) {
+            std::lock_guard<std::mutex> lck(observerMtx);
+            writerObserver = observer;
+        }
+
         void free() {
-            if (writeBuf) { buffer::free(writeBuf); }
-            if (readBuf) { buffer::free(readBuf); }
+            if (writeBuf) { releaseShared(); }
+            if (ringSlots) {
+                for (auto& buf : ringBufs) { buffer::free(buf); }
+                ringBufs.clear();
+                buffer::free(ringSpare);
+                ringSpare = NULL;
+            }
+            else {
+                if (writeBuf) { buffer::free(writeBuf); }
+                if (readBuf) { buffer::free(readBuf); }
+            }
             writeBuf = NULL;
             readBuf = NULL;
         }
 
-        T* writeBuf;
-        T* readBuf;
+        T* writeBuf = NULL;
+        T* readBuf = NULL;
 
     private:
+        void allocBuffers() {
+            if (!ringSlots) {
+                writeBuf = buffer::alloc<T>(bufferSize);
+                readBuf = buffer::alloc<T>(bufferSize);
+                return;
+            }
+            ringBufs.resize(ringSlots);
+            ringSizes.assign(ringSlots, 0);
+            ringShared.assign(ringSlots, NULL);
+            ringRefs.assign(ringSlots, NULL);
+            for (auto& buf : ringBufs) { buf = buffer::alloc<T>(bufferSize); }
+            ringSpare = buffer::alloc<T>(bufferSize);
+            spareInUse = false;
+            ringHead = 0;
+            ringTail = 0;
+            readPending = false;
+            writeBuf = ringBufs[0];
+            readBuf = ringBufs[0];
+        }
+
+        inline void notifyObserver(std::atomic<stream_observer*>& observer) {
+            // The lock guarantees that the observer isn't detached (and possibly destroyed) while it's being notified
+            if (!observer.load()) { return; }
+            std::lock_guard<std::mutex> lck(observerMtx);
+            stream_observer* obs = observer.load();
+            if (obs) { obs->streamReady(); }
+        }
+
+        inline bool ringSwap(int size, const T* shared = NULL, shared_buffer_ref* ref = NULL) {
+            if (writerStop) { return false; }
+
+            // If the data was written to the spare buffer, trade it for the slot once the reader released it
+            uint64_t head = ringHead.load(std::memory_order_relaxed);
+            if (spareInUse) {
+                if (!ringWait(swapMtx, swapCV, writerParked, writerStop, [this, head]() { return head - ringTail.load() < (uint64_t)ringSlots; })) {
+                    return false;
+                }
+                std::swap(ringBufs[head % ringSlots], ringSpare);
+                spareInUse = false;
+            }
+
+            // Publish the buffer that was just written, or the shared buffer instead
+            ringSizes[head % ringSlots] = size;
+            ringShared[head % ringSlots] = (T*)shared;
+            ringRefs[head % ringSlots] = ref;
+            ringHead.store(++head);
+            if (readerParked.load()) {
+                { std::lock_guard<std::mutex> lck(rdyMtx); }
+                rdyCV.notify_all();
+            }
+            notifyObserver(readerObserver);
+
+            // Wait for the next slot to be released by the reader. If stopped, the slot may still be in use,
+            // so the writer gets the spare buffer to write to in the meantime.
+            if (!ringWait(swapMtx, swapCV, writerParked, writerStop, [this, head]() { return head - ringTail.load() < (uint64_t)ringSlots; })) {
+                writeBuf = ringSpare;
+                spareInUse = true;
+                return false;
+            }
+            writeBuf = ringBufs[head % ringSlots];
+            return true;
+        }
+
+        inline int ringRead() {
+            // If the previous buffer wasn't flushed yet, return it again
+            uint64_t tail = ringTail.load(std::memory_order_relaxed);
+            if (readPending) { return readerStop ? -1 : ringSizes[tail % ringSlots]; }
+
+            // Wait for the writer to publish a buffer
+            if (!ringWait(rdyMtx, rdyCV, readerParked, readerStop, [this, tail]() { return ringHead.load() != tail; })) {
+                return -1;
+            }
+            T* shared = ringShared[tail % ringSlots];
+            readBuf = shared ? shared : ringBufs[tail % ringSlots];
+            readPending = true;
+            return ringSizes[tail % ringSlots];
+        }
+
+        inline void ringFlush() {
+            if (!readPending) { return; }
+            readPending = false;
+
+            // Clear the shared buffer before releasing the slot since the writer could reuse it right away
+            uint64_t tail = ringTail.load(std::memory_order_relaxed);
+            shared_buffer_ref* ref = ringRefs[tail % ringSlots];
+            ringRefs[tail % ringSlots] = NULL;
+            ringShared[tail % ringSlots] = NULL;
+            ringTail.fetch_add(1);
+            if (ref) { ref->release(); }
+            if (writerParked.load()) {
+                { std::lock_guard<std::mutex> lck(swapMtx); }
+                swapCV.notify_all();
+            }
+            notifyObserver(writerObserver);
+        }
+
+        // Returns false if the wait was ended by a stop request instead of the condition
+        template <typename Func>
+        inline bool ringWait(std::mutex& mtx, std::condition_variable& cv, std::atomic<bool>& parked, std::atomic<bool>& stop, Func cond) {
+            if (waitPolicy == STREAM_WAIT_SPIN) {
+                for (int i = 1; i <= STREAM_RING_SPIN_COUNT; i++) {
+                    if (cond() || stop) { return !stop; }
+                    if (!(i & 0xFF)) { std::this_thread::yield(); }
+                }
+            }
+
+            // Park until the other side makes progress. The parked flag is raised before the
+            // condition is re-checked so that the other side can't miss the wakeup.
+            std::unique_lock<std::mutex> lck(mtx);
+            parked.store(true);
+            cv.wait(lck, [&]() { return cond() || stop; });
+            parked.store(false);
+            return !stop;
+        }
+
         std::mutex swapMtx;
         std::condition_variable swapCV;
         bool canSwap = true;
@@ -134,9 +466,33 @@ namespace dsp {
         std::condition_variable rdyCV;
         bool dataReady = false;
 
-        bool readerStop = false;
-        bool writerStop = false;
+        std::atomic<bool> readerStop = false;
+        std::atomic<bool> writerStop = false;
 
         int dataSize = 0;
+        int bufferSize = STREAM_BUFFER_SIZE;
+
+        // Buffer lent by swapShared(), only used in double-buffer mode
+        shared_buffer_ref* sharedRef = NULL;
+        T* ownedReadBuf = NULL;
+
+        std::mutex observerMtx;
+        std::atomic<stream_observer*> readerObserver = NULL;
+        std::atomic<stream_observer*> writerObserver = NULL;
+
+        // Ring transport state, only used when ringSlots is non-zero
+        int ringSlots = 0;
+        StreamWaitPolicy waitPolicy = STREAM_WAIT_SPIN;
+        std::vector<T*> ringBufs;
+        std::vector<int> ringSizes;
+        std::vector<T*> ringShared;
+        std::vector<shared_buffer_ref*> ringRefs;
+        T* ringSpare = NULL;
+        bool spareInUse = false;
+        alignas(64) std::atomic<uint64_t> ringHead = 0;
+        alignas(64) std::atomic<uint64_t> ringTail = 0;
+        std::atomic<bool> readerParked = false;
+        std::atomic<bool> writerParked = false;
+        bool readPending = false;
     };
 }
\ No newline at end of file
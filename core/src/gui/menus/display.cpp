@@ -27,6 +27,8 @@ namespace displaymenu {
     bool fftSmoothing = false;
     int fftSmoothingSpeed = 100;
     bool snrSmoothing = false;
+    bool fftAveraging = false;
+    bool fftMeasuredPlans = false;
     int snrSmoothingSpeed = 20;
 
     OptionList<int, int> fftSizes;
@@ -91,6 +93,11 @@ namespace displaymenu {
         selectedWindow = std::clamp<int>((int)core::configManager.conf["fftWindow"], 0, (sizeof(fftWindowList) / sizeof(IQFrontEnd::FFTWindow)) - 1);
         sigpath::iqFrontEnd.setFFTWindow(fftWindowList[selectedWindow]);
 
+        fftAveraging = core::configManager.conf["fftAveraging"];
+        sigpath::iqFrontEnd.setFFTAveraging(fftAveraging);
+
+        fftMeasuredPlans = core::configManager.conf["fftMeasuredPlans"];
+
         gui::menu.locked = core::configManager.conf["lockMenuOrder"];
 
         fftHold = core::configManager.conf["fftHold"];
@@ -192,6 +199,21 @@ namespace displaymenu {
             core::configManager.release(true);
         }
 
+        if (ImGui::Checkbox("FFT Averaging##_sdrpp", &fftAveraging)) {
+            sigpath::iqFrontEnd.setFFTAveraging(fftAveraging);
+            core::configManager.acquire();
+            core::configManager.conf["fftAveraging"] = fftAveraging;
+            core::configManager.release(true);
+        }
+
+        if (ImGui::Checkbox("Measured FFT Plans##_sdrpp", &fftMeasuredPlans)) {
+            dsp::fft::planCache.setMode(fftMeasuredPlans ? dsp::fft::PLAN_MODE_MEASURE : dsp::fft::PLAN_MODE_ESTIMATE);
+            dsp::fft::planCache.warmup({ fftSizes.value(fftSizeId) });
+            core::configManager.acquire();
+            core::configManager.conf["fftMeasuredPlans"] = fftMeasuredPlans;
+            core::configManager.release(true);
+        }
+
         ImGui::LeftLabel("High-DPI Scaling");
         ImGui::FillWidth();
         if (ImGui::Combo("##sdrpp_ui_scale", &uiScaleId, uiScales.txt)) {
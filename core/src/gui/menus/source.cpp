@@ -18,6 +18,9 @@ namespace sourcemenu {
     int decimId = 0;
     OptionList<int, int> decimations;
 
+    int channelizerId = 0;
+    OptionList<int, int> channelizerModes;
+
     bool iqCorrection = false;
     bool invertIQ = false;
 
@@ -167,6 +170,15 @@ namespace sourcemenu {
         decimations.define(32, "32x", 32);
         decimations.define(64, "64x", 64);
 
+        // Define channelizer channel counts
+        channelizerModes.define(0, "Disabled", 0);
+        channelizerModes.define(16, "16 channels", 16);
+        channelizerModes.define(32, "32 channels", 32);
+        channelizerModes.define(64, "64 channels", 64);
+        channelizerModes.define(128, "128 channels", 128);
+        channelizerModes.define(256, "256 channels", 256);
+        channelizerModes.define(512, "512 channels", 512);
+
         // Acquire the config file
         core::configManager.acquire();
 
@@ -180,6 +192,10 @@ namespace sourcemenu {
         if (decimations.keyExists(decimation)) {
             decimId = decimations.keyId(decimation);
         }
+        int channelizer = core::configManager.conf["channelizer"];
+        if (channelizerModes.keyExists(channelizer)) {
+            channelizerId = channelizerModes.keyId(channelizer);
+        }
 
         // Release the config file
         core::configManager.release();
@@ -192,6 +208,7 @@ namespace sourcemenu {
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
         sigpath::iqFrontEnd.setDecimation(decimations.value(decimId));
+        sigpath::iqFrontEnd.setChannelizer(channelizerModes.value(channelizerId));
         selectOffsetByName(selectedOffset);
 
         // Register handlers
@@ -374,5 +391,14 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
         if (running) { style::endDisabled(); }
+
+        ImGui::LeftLabel("Channelizer");
+        ImGui::FillWidth();
+        if (ImGui::Combo("##source_channelizer", &channelizerId, channelizerModes.txt)) {
+            sigpath::iqFrontEnd.setChannelizer(channelizerModes.value(channelizerId));
+            core::configManager.acquire();
+            core::configManager.conf["channelizer"] = channelizerModes.key(channelizerId);
+            core::configManager.release(true);
+        }
     }
 }
@@ -7,6 +7,7 @@
 #include <utils/flog.h>
 #include <gui/gui.h>
 #include <gui/style.h>
+#include <signal_path/signal_path.h>
 
 float DEFAULT_COLOR_MAP[][3] = {
     { 0x00, 0x00, 0x20 },
@@ -62,7 +63,52 @@ inline void printAndScale(double freq, char* buf) {
     }
 }
 
-inline void doZoom(int offset, int width, int inSize, int outSize, float* in, float* out) {
+// Max of in[start, end), coarser pyramid levels are used for the aligned middle of the range
+inline float rangeMax(const float* in, const float* pyramid, const std::vector<int>& levels, int start, int end) {
+    float maxVal = -INFINITY;
+    const float* level = in;
+    int k = 0;
+    while (start < end) {
+        // Once the range is small or there is no coarser level, scan what's left
+        if (end - start <= 2 * WATERFALL_PYRAMID_FACTOR || k == levels.size()) {
+            for (int i = start; i < end; i++) {
+                if (level[i] > maxVal) { maxVal = level[i]; }
+            }
+            break;
+        }
+
+        // Scan the unaligned ends and go up one level
+        for (; start % WATERFALL_PYRAMID_FACTOR; start++) {
+            if (level[start] > maxVal) { maxVal = level[start]; }
+        }
+        for (; end % WATERFALL_PYRAMID_FACTOR; end--) {
+            if (level[end - 1] > maxVal) { maxVal = level[end - 1]; }
+        }
+        level = &pyramid[levels[k++]];
+        start /= WATERFALL_PYRAMID_FACTOR;
+        end /= WATERFALL_PYRAMID_FACTOR;
+    }
+    return maxVal;
+}
+
+// Map dB values to palette colors. The indices are computed in blocks by a branchless loop that the
+// compiler can vectorize, the palette lookups are then done separately.
+inline void colorize(const float* in, uint32_t* out, int count, float min, float max, const uint32_t* palette) {
+    float scale = (float)(WATERFALL_RESOLUTION - 1) / (max - min);
+    int ids[WATERFALL_COLORIZE_BLOCK];
+    for (int i = 0; i < count; i += WATERFALL_COLORIZE_BLOCK) {
+        int n = std::min<int>(WATERFALL_COLORIZE_BLOCK, count - i);
+        for (int j = 0; j < n; j++) {
+            float val = std::min<float>(std::max<float>(in[i + j], min), max);
+            ids[j] = (int)((val - min) * scale);
+        }
+        for (int j = 0; j < n; j++) {
+            out[i + j] = palette[ids[j]];
+        }
+    }
+}
+
+inline void doZoom(int offset, int width, int inSize, int outSize, float* in, float* pyramid, const std::vector<int>& levels, float* out) {
     // NOTE: REMOVE THAT SHIT, IT'S JUST A HACKY FIX
     if (offset < 0) {
         offset = 0;
@@ -75,16 +121,11 @@ inline void doZoom(int offset, int width, int inSize, int outSize, float* in, fl
     float sFactor = ceilf(factor);
     float uFactor;
     float id = offset;
-    float maxVal;
     int sId;
     for (int i = 0; i < outSize; i++) {
-        maxVal = -INFINITY;
         sId = (int)id;
         uFactor = (sId + sFactor > inSize) ? sFactor - ((sId + sFactor) - inSize) : sFactor;
-        for (int j = 0; j < uFactor; j++) {
-            if (in[sId + j] > maxVal) { maxVal = in[sId + j]; }
-        }
-        out[i] = maxVal;
+        out[i] = rangeMax(in, pyramid, levels, sId, sId + (int)uFactor);
         id += factor;
     }
 }
@@ -211,8 +252,14 @@ namespace ImGui {
             updateWaterfallTexture();
         }
         {
+            // Draw from the newest line to the bottom of the texture, then the lines that wrapped around to its top
             std::lock_guard<std::mutex> lck(texMtx);
-            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, wfMax);
+            float headV = (float)fbHead / (float)waterfallHeight;
+            float split = wfMin.y + (float)(waterfallHeight - fbHead);
+            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, ImVec2(wfMax.x, split), ImVec2(0.0f, headV), ImVec2(1.0f, 1.0f));
+            if (fbHead) {
+                window->DrawList->AddImage((void*)(intptr_t)textureId, ImVec2(wfMin.x, split), wfMax, ImVec2(0.0f, 0.0f), ImVec2(1.0f, headV));
+            }
         }
         
         ImVec2 mPos = ImGui::GetMousePos();
@@ -602,23 +649,20 @@ namespace ImGui {
             return;
         }
         double offsetRatio = viewOffset / (wholeBandwidth / 2.0);
-        int drawDataSize;
-        int drawDataStart;
-        // TODO: Maybe put on the stack for faster alloc?
-        float* tempData = new float[dataWidth];
-        float pixel;
-        float dataRange = waterfallMax - waterfallMin;
+        int drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
+        int drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
         int count = std::min<float>(waterfallHeight, fftLines);
         if (rawFFTs != NULL && fftLines >= 0) {
-            for (int i = 0; i < count; i++) {
-                drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
-                drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
-                doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[((i + currentFFTLine) % waterfallHeight) * rawFFTSize], tempData);
-                for (int j = 0; j < dataWidth; j++) {
-                    pixel = (std::clamp<float>(tempData[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                    waterfallFb[(i * dataWidth) + j] = waterfallPallet[(int)(pixel * (WATERFALL_RESOLUTION - 1))];
+            // Lines are independent, redraw blocks of them on the DSP worker pool
+            int blockCount = (count + WATERFALL_REDRAW_BLOCK - 1) / WATERFALL_REDRAW_BLOCK;
+            sigpath::dspPool.parallelFor(blockCount, [&](int block) {
+                std::vector<float> tempData(dataWidth);
+                int end = std::min<int>((block + 1) * WATERFALL_REDRAW_BLOCK, count);
+                for (int i = block * WATERFALL_REDRAW_BLOCK; i < end; i++) {
+                    zoomLine((i + currentFFTLine) % waterfallHeight, drawDataStart, drawDataSize, tempData.data());
+                    colorize(tempData.data(), &waterfallFb[i * dataWidth], dataWidth, waterfallMin, waterfallMax, waterfallPallet);
                 }
-            }
+            });
 
             for (int i = count; i < waterfallHeight; i++) {
                 for (int j = 0; j < dataWidth; j++) {
@@ -626,7 +670,8 @@ namespace ImGui {
                 }
             }
         }
-        delete[] tempData;
+        fbHead = 0;
+        fbFullUpload = true;
         waterfallUpdate = true;
     }
 
@@ -704,10 +749,65 @@ namespace ImGui {
     void WaterFall::updateWaterfallTexture() {
         std::lock_guard<std::mutex> lck(texMtx);
         glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+
+        // Reallocate the whole texture if it changed size or if all of it needs updating anyway
+        if (fbFullUpload || fbNewLines >= waterfallHeight || texWidth != dataWidth || texHeight != waterfallHeight) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+            texWidth = dataWidth;
+            texHeight = waterfallHeight;
+            fbFullUpload = false;
+            fbNewLines = 0;
+            return;
+        }
+
+        // Otherwise, only upload the new lines. They start at the head and may wrap around to the top.
+        int firstCount = std::min<int>(fbNewLines, waterfallHeight - fbHead);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, fbHead, dataWidth, firstCount, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)&waterfallFb[fbHead * dataWidth]);
+        if (fbNewLines > firstCount) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, dataWidth, fbNewLines - firstCount, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+        }
+        fbNewLines = 0;
+    }
+
+    void WaterFall::allocPyramids() {
+        // Each level is the previous one decimated by WATERFALL_PYRAMID_FACTOR, stop once it gets too small to be useful
+        pyramidLevels.clear();
+        pyramidSize = 0;
+        for (int size = rawFFTSize / WATERFALL_PYRAMID_FACTOR; size >= WATERFALL_PYRAMID_FACTOR; size /= WATERFALL_PYRAMID_FACTOR) {
+            pyramidLevels.push_back(pyramidSize);
+            pyramidSize += size;
+        }
+
+        int lines = std::max<int>(1, waterfallHeight);
+        if (fftPyramids) { free(fftPyramids); }
+        fftPyramids = (float*)malloc(std::max<int>(1, pyramidSize * lines) * sizeof(float));
+        for (int i = 0; i < lines; i++) { updatePyramid(i); }
+    }
+
+    void WaterFall::updatePyramid(int line) {
+        const float* prev = &rawFFTs[line * rawFFTSize];
+        int prevSize = rawFFTSize;
+        for (int offset : pyramidLevels) {
+            float* level = &fftPyramids[(line * pyramidSize) + offset];
+            int size = prevSize / WATERFALL_PYRAMID_FACTOR;
+            for (int i = 0; i < size; i++) {
+                const float* group = &prev[i * WATERFALL_PYRAMID_FACTOR];
+                float maxVal = group[0];
+                for (int j = 1; j < WATERFALL_PYRAMID_FACTOR; j++) {
+                    if (group[j] > maxVal) { maxVal = group[j]; }
+                }
+                level[i] = maxVal;
+            }
+            prev = level;
+            prevSize = size;
+        }
+    }
+
+    void WaterFall::zoomLine(int line, int offset, int width, float* out) {
+        doZoom(offset, width, rawFFTSize, dataWidth, &rawFFTs[line * rawFFTSize], &fftPyramids[line * pyramidSize], pyramidLevels, out);
     }
 
     void WaterFall::onPositionChange() {
@@ -753,6 +853,7 @@ namespace ImGui {
             else {
                 rawFFTs = (float*)malloc(waterfallHeight * rawFFTSize * sizeof(float));
             }
+            allocPyramids();
             // ==============
         }
 
@@ -781,6 +882,9 @@ namespace ImGui {
             delete[] waterfallFb;
             waterfallFb = new uint32_t[dataWidth * waterfallHeight];
             memset(waterfallFb, 0, dataWidth * waterfallHeight * sizeof(uint32_t));
+            fbHead = 0;
+            fbNewLines = 0;
+            fbFullUpload = true;
         }
         for (int i = 0; i < dataWidth; i++) {
             latestFFT[i] = -1000.0f; // Hide everything
@@ -894,19 +998,18 @@ namespace ImGui {
         int drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
 
         if (waterfallVisible) {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], latestFFT);
-            memmove(&waterfallFb[dataWidth], waterfallFb, dataWidth * (waterfallHeight - 1) * sizeof(uint32_t));
-            float pixel;
-            float dataRange = waterfallMax - waterfallMin;
-            for (int j = 0; j < dataWidth; j++) {
-                pixel = (std::clamp<float>(latestFFT[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                int id = (int)(pixel * (WATERFALL_RESOLUTION - 1));
-                waterfallFb[j] = waterfallPallet[id];
-            }
+            updatePyramid(currentFFTLine);
+            zoomLine(currentFFTLine, drawDataStart, drawDataSize, latestFFT);
+
+            // Move the head up one row instead of scrolling the whole framebuffer
+            fbHead = (fbHead + waterfallHeight - 1) % waterfallHeight;
+            colorize(latestFFT, &waterfallFb[fbHead * dataWidth], dataWidth, waterfallMin, waterfallMax, waterfallPallet);
+            fbNewLines = std::min<int>(fbNewLines + 1, waterfallHeight);
             waterfallUpdate = true;
         }
         else {
-            doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, rawFFTs, latestFFT);
+            updatePyramid(0);
+            zoomLine(0, drawDataStart, drawDataSize, latestFFT);
             fftLines = 1;
         }
 
@@ -1143,9 +1246,14 @@ namespace ImGui {
         }
         fftLines = 0;
         memset(rawFFTs, 0, rawFFTSize * waterfallHeight * sizeof(float));
+        allocPyramids();
         updateWaterfallFb();
     }
 
+    int WaterFall::getRawFFTSize() {
+        return rawFFTSize;
+    }
+
     void WaterFall::setBandPlanPos(int pos) {
         bandPlanPos = pos;
     }
@@ -1389,6 +1497,7 @@ namespace ImGui {
         waterfallVisible = true;
         onResize();
         memset(rawFFTs, 0, waterfallHeight * rawFFTSize * sizeof(float));
+        allocPyramids();
         updateWaterfallFb();
         buf_mtx.unlock();
     }
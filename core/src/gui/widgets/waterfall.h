@@ -10,6 +10,13 @@
 
 #define WATERFALL_RESOLUTION 1000000
 
+// Decimation factor between two levels of the FFT max pyramid
+#define WATERFALL_PYRAMID_FACTOR 4
+
+// Number of values colorized at once and number of lines redrawn per worker task
+#define WATERFALL_COLORIZE_BLOCK 256
+#define WATERFALL_REDRAW_BLOCK 16
+
 namespace ImGui {
     class WaterfallVFO {
     public:
@@ -134,6 +141,7 @@ namespace ImGui {
         int getFFTHeight();
 
         void setRawFFTSize(int size);
+        int getRawFFTSize();
 
         void setFullWaterfallUpdate(bool fullUpdate);
 
@@ -228,6 +236,9 @@ namespace ImGui {
         void onResize();
         void updateWaterfallFb();
         void updateWaterfallTexture();
+        void allocPyramids();
+        void updatePyramid(int line);
+        void zoomLine(int line, int offset, int width, float* out);
         void updateAllVFOs(bool checkRedrawRequired = false);
         bool calculateVFOSignalInfo(float* fftLine, WaterfallVFO* vfo, float& strength, float& snr);
 
@@ -290,7 +301,18 @@ namespace ImGui {
         int currentFFTLine = 0;
         int fftLines = 0;
 
+        // Max decimation pyramid of every stored FFT line, so that zooming doesn't need to scan every bin
+        float* fftPyramids = NULL;
+        int pyramidSize = 0;
+        std::vector<int> pyramidLevels; // Offset of each level in the pyramid of a line
+
+        // Circular framebuffer, the newest line is at row fbHead and older ones follow, wrapping around
         uint32_t* waterfallFb;
+        int fbHead = 0;
+        int fbNewLines = 0;         // Lines pushed since the last texture upload
+        bool fbFullUpload = true;   // Every line changed, upload the whole framebuffer
+        int texWidth = 0;
+        int texHeight = 0;
 
         bool draggingFW = false;
         int FFTAreaHeight;
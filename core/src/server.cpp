@@ -4,76 +4,48 @@
 #include <version.h>
 #include <config.h>
 #include <filesystem>
+#include <algorithm>
+#include <list>
 #include <dsp/types.h>
 #include <signal_path/signal_path.h>
 #include <gui/smgui.h>
 #include <utils/optionlist.h>
-#include "dsp/compression/sample_stream_compressor.h"
-#include "dsp/sink/handler_sink.h"
-#include <zstd.h>
+#include "dsp/compression/spectrum_codec.h"
 
 namespace server {
     dsp::stream<dsp::complex_t> dummyInput;
-    dsp::compression::SampleStreamCompressor comp;
-    dsp::sink::Handler<uint8_t> hnd;
-    net::Conn client;
-    uint8_t* rbuf = NULL;
-    uint8_t* sbuf = NULL;
-    uint8_t* bbuf = NULL;
-
-    PacketHeader* r_pkt_hdr = NULL;
-    uint8_t* r_pkt_data = NULL;
-    CommandHeader* r_cmd_hdr = NULL;
-    uint8_t* r_cmd_data = NULL;
-
-    PacketHeader* s_pkt_hdr = NULL;
-    uint8_t* s_pkt_data = NULL;
-    CommandHeader* s_cmd_hdr = NULL;
-    uint8_t* s_cmd_data = NULL;
-
-    PacketHeader* bb_pkt_hdr = NULL;
-    uint8_t* bb_pkt_data = NULL;
 
     SmGui::DrawListElem dummyElem;
 
-    ZSTD_CCtx* cctx;
-
     net::Listener listener;
 
     OptionList<std::string, std::string> sourceList;
     int sourceId = 0;
-    bool running = false;
-    bool compression = false;
     double sampleRate = 1000000.0;
 
-    int main() {
-        flog::info("=====| SERVER MODE |=====");
+    // Connected clients, the FFT thread walks the list while holding sessionsMtx
+    std::mutex sessionsMtx;
+    std::list<Session*> sessions;
+    int nextSessionId = 0;
 
-        // Init DSP
-        comp.init(&dummyInput, dsp::compression::PCM_TYPE_I8);
-        hnd.init(&comp.out, _testServerHandler, NULL);
-        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        bbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
-        comp.start();
-        hnd.start();
+    // Serializes commands from all clients along with everything that reconfigures the source or front end
+    std::mutex cmdMtx;
+    int runningSessions = 0;
 
-        // Initialize headers
-        r_pkt_hdr = (PacketHeader*)rbuf;
-        r_pkt_data = &rbuf[sizeof(PacketHeader)];
-        r_cmd_hdr = (CommandHeader*)r_pkt_data;
-        r_cmd_data = &rbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
+    // Shared FFT, fftMtx is held by the FFT thread from buffer acquisition to release
+    std::mutex fftMtx;
+    bool fftEnabled = false;
+    int fftSize = 1024;
+    float fftRate = 20.0f;
+    float* fftLine = NULL;
 
-        s_pkt_hdr = (PacketHeader*)sbuf;
-        s_pkt_data = &sbuf[sizeof(PacketHeader)];
-        s_cmd_hdr = (CommandHeader*)s_pkt_data;
-        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-
-        bb_pkt_hdr = (PacketHeader*)bbuf;
-        bb_pkt_data = &bbuf[sizeof(PacketHeader)];
+    int main() {
+        flog::info("=====| SERVER MODE |=====");
 
-        // Initialize compressor
-        cctx = ZSTD_createCCtx();
+        // Init DSP, the front end feeds every client's baseband compressor and the FFT
+        fftLine = dsp::buffer::alloc<float>(SERVER_MAX_FFT_SIZE);
+        sigpath::iqFrontEnd.init(&dummyInput, sampleRate, false, 1, false, fftSize, fftRate, IQFrontEnd::FFTWindow::NUTTALL, _fftAcquire, _fftRelease, NULL);
+        sigpath::iqFrontEnd.start();
 
         // Load config
         core::configManager.acquire();
@@ -155,98 +127,475 @@ namespace server {
         listener->acceptAsync(_clientHandler, NULL);
 
         flog::info("Ready, listening on {0}:{1}", host, port);
-        while(1) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+        int ticks = 0;
+        while(1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            removeClosedSessions();
+            if (!(++ticks % 10)) { broadcastStats(); }
+        }
 
         return 0;
     }
 
     void _clientHandler(net::Conn conn, void* ctx) {
-        // Reject if someone else is already connected
-        if (client && client->isOpen()) {
-            flog::info("REJECTED Connection from {0}:{1}, another client is already connected.", "TODO", "TODO");
-            
-            // Issue a disconnect command to the client
-            uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader)];
-            PacketHeader* tmp_phdr = (PacketHeader*)buf;
-            CommandHeader* tmp_chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
-            tmp_phdr->size = sizeof(PacketHeader) + sizeof(CommandHeader);
-            tmp_phdr->type = PACKET_TYPE_COMMAND;
-            tmp_chdr->cmd = COMMAND_DISCONNECT;
-            conn->write(tmp_phdr->size, buf);
-
-            // TODO: Find something cleaner
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        flog::info("Connection from {0}:{1}", "TODO", "TODO");
+        {
+            std::lock_guard<std::mutex> lck(cmdMtx);
+            Session* session = new Session(std::move(conn), nextSessionId++);
+            std::lock_guard<std::mutex> lck2(sessionsMtx);
+            sessions.push_back(session);
+        }
 
-            conn->close();
-            
-            // Start another async accept
-            listener->acceptAsync(_clientHandler, NULL);
-            return;
+        listener->acceptAsync(_clientHandler, NULL);
+    }
+
+    void broadcastStats() {
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        for (auto& session : sessions) {
+            session->sendStats();
         }
+    }
 
-        flog::info("Connection from {0}:{1}", "TODO", "TODO");
-        client = std::move(conn);
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+    void removeClosedSessions() {
+        std::vector<Session*> closed;
+        {
+            std::lock_guard<std::mutex> lck(sessionsMtx);
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                if ((*it)->isOpen()) { it++; continue; }
+                closed.push_back(*it);
+                it = sessions.erase(it);
+            }
+        }
+        if (closed.empty()) { return; }
 
-        // Perform settings reset
-        sigpath::sourceManager.stop();
-        comp.setPCMType(dsp::compression::PCM_TYPE_I16);
-        compression = false;
+        // Now that the FFT thread can't see them anymore, tear them down
+        for (auto& session : closed) {
+            flog::info("Client disconnected");
+            delete session;
+        }
+
+        std::lock_guard<std::mutex> lck(cmdMtx);
+        updateFFT();
+    }
+
+    Session::Session(net::Conn conn, int id) {
+        this->id = id;
+        this->conn = std::move(conn);
+
+        rbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        sbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        fbuf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        fftZoom = dsp::buffer::alloc<float>(SERVER_MAX_FFT_WIDTH);
+        fftCodeBuf = new uint8_t[sizeof(dsp::compression::SpectrumHeader) + SERVER_MAX_FFT_WIDTH];
 
+        // Initialize headers
+        r_pkt_hdr = (PacketHeader*)rbuf;
+        r_pkt_data = &rbuf[sizeof(PacketHeader)];
+
+        s_pkt_hdr = (PacketHeader*)sbuf;
+        s_pkt_data = &sbuf[sizeof(PacketHeader)];
+        s_cmd_hdr = (CommandHeader*)s_pkt_data;
+        s_cmd_data = &sbuf[sizeof(PacketHeader) + sizeof(CommandHeader)];
+
+        f_pkt_hdr = (PacketHeader*)fbuf;
+        f_fft_hdr = (FFTHeader*)&fbuf[sizeof(PacketHeader)];
+        f_fft_data = &fbuf[sizeof(PacketHeader) + sizeof(FFTHeader)];
+
+        // Initialize compressors
+        fctx = ZSTD_createCCtx();
+        fftSettings = { false, false, 1024, 1024, 20.0f, 0.0, 0.0 };
+
+        // Init DSP, the baseband isn't bound to the front end until full IQ is enabled
+        int threads = std::clamp<int>(std::thread::hardware_concurrency() / 2, 1, SERVER_MAX_COMPRESSION_THREADS);
+        pipeline.init(threads, SERVER_MAX_PIPELINE_BYTES, SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader), sizeof(PacketHeader), _compressedHandler, this);
+        comp.init(&iqStream, pcmType);
+        hnd.init(&comp.out, _basebandHandler, this);
+        pipeline.start();
+        comp.start();
+        hnd.start();
+
+        sendThread = std::thread(&Session::sendWorker, this);
+
+        // Clients get the full baseband unless they ask otherwise
+        setFullIQ(true);
         sendSampleRate(sampleRate);
 
-        // TODO: Wait otherwise someone else could connect
+        this->conn->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, this);
+    }
 
-        listener->acceptAsync(_clientHandler, NULL);
+    Session::~Session() {
+        // Stop sending first, anything still produced by the compressors is discarded
+        {
+            std::lock_guard<std::mutex> lck(sendMtx);
+            stopSender = true;
+        }
+        sendCnd.notify_all();
+        if (sendThread.joinable()) { sendThread.join(); }
+
+        // Close the connection without holding cmdMtx, the read thread might be waiting on it
+        conn->close();
+
+        {
+            std::lock_guard<std::mutex> lck(cmdMtx);
+            while (!vfos.empty()) { removeVFO(vfos.begin()->first); }
+            setFullIQ(false);
+            setRunning(false);
+        }
+        hnd.stop();
+        comp.stop();
+        pipeline.stop();
+
+        ZSTD_freeCCtx(fctx);
+        delete[] rbuf;
+        delete[] sbuf;
+        delete[] fbuf;
+        dsp::buffer::free(fftZoom);
+        delete[] fftCodeBuf;
     }
 
-    void _packetHandler(int count, uint8_t* buf, void* ctx) {
+    bool Session::isOpen() {
+        return conn && conn->isOpen() && !dropClient;
+    }
+
+    void Session::_packetHandler(int count, uint8_t* buf, void* ctx) {
+        Session* _this = (Session*)ctx;
         PacketHeader* hdr = (PacketHeader*)buf;
 
-        // Read the rest of the data (TODO: CHECK SIZE OR SHIT WILL BE FUCKED + ADD TIMEOUT)
+        // A size that doesn't fit the receive buffer can't be skipped safely, so the client is dropped. The
+        // connection can't be closed from its own read thread, the main loop tears the session down instead
+        if (hdr->size < sizeof(PacketHeader) || hdr->size > SERVER_MAX_PACKET_SIZE) {
+            flog::error("Client {0} sent a packet of invalid size ({1} bytes), disconnecting", _this->id, hdr->size);
+            _this->dropClient = true;
+            return;
+        }
+
+        // Read the rest of the data
         int len = 0;
         int read = 0;
         int goal = hdr->size - sizeof(PacketHeader);
         while (len < goal) {
-            read = client->read(goal - len, &buf[sizeof(PacketHeader) + len]);
+            read = _this->conn->read(goal - len, &buf[sizeof(PacketHeader) + len]);
             if (read < 0) { return; };
             len += read;
         }
 
         // Parse and process
-        if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
-            CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
-            commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
-        }
-        else {
-            sendError(ERROR_INVALID_PACKET);
+        {
+            std::lock_guard<std::mutex> lck(cmdMtx);
+            if (hdr->type == PACKET_TYPE_COMMAND && hdr->size >= sizeof(PacketHeader) + sizeof(CommandHeader)) {
+                CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
+                _this->commandHandler((Command)chdr->cmd, &buf[sizeof(PacketHeader) + sizeof(CommandHeader)], hdr->size - sizeof(PacketHeader) - sizeof(CommandHeader));
+            }
+            else {
+                _this->sendError(ERROR_INVALID_PACKET);
+            }
         }
 
         // Start another async read
-        client->readAsync(sizeof(PacketHeader), rbuf, _packetHandler, NULL);
+        _this->conn->readAsync(sizeof(PacketHeader), _this->rbuf, _packetHandler, _this);
+    }
+
+    void Session::_basebandHandler(uint8_t* data, int count, void* ctx) {
+        Session* _this = (Session*)ctx;
+
+        // Only copy here, compression happens on the pipeline's threads so it never holds back the DSP
+        _this->pipeline.push(data, count, _this->compression);
     }
 
-    void _testServerHandler(uint8_t* data, int count, void* ctx) {
+    void Session::_compressedHandler(uint8_t* buf, int len, bool compressed, void* ctx) {
+        Session* _this = (Session*)ctx;
+
+        // The pipeline leaves room for the header in front of the data
+        PacketHeader* hdr = (PacketHeader*)buf;
+        hdr->type = compressed ? PACKET_TYPE_BASEBAND_COMPRESSED : PACKET_TYPE_BASEBAND;
+        hdr->size = sizeof(PacketHeader) + len;
+        _this->queuePacket(buf, hdr->size, true);
+
+        // Let the pipeline know how backed up the link is
+        int queued;
+        {
+            std::lock_guard<std::mutex> lck(_this->sendMtx);
+            queued = _this->queuedBytes;
+        }
+        _this->pipeline.setLinkLoad((float)queued / (float)SERVER_MAX_QUEUED_BYTES);
+    }
+
+    void Session::_vfoHandler(uint8_t* data, int count, void* ctx) {
+        RemoteVFO* rvfo = (RemoteVFO*)ctx;
+
         // Compress data if needed and fill out header fields
+        rvfo->vfo_hdr->id = rvfo->settings.id;
+        rvfo->vfo_hdr->flags = 0;
+        int len = count;
+        if (rvfo->session->compression) {
+            size_t clen = ZSTD_compressCCtx(rvfo->cctx, rvfo->data, SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader) - sizeof(VFOHeader), data, count, 1);
+            if (ZSTD_isError(clen)) { return; }
+            len = clen;
+            rvfo->vfo_hdr->flags |= VFO_FLAG_COMPRESSED;
+        }
+        else {
+            memcpy(rvfo->data, data, count);
+        }
+        rvfo->pkt_hdr->type = PACKET_TYPE_VFO;
+        rvfo->pkt_hdr->size = sizeof(PacketHeader) + sizeof(VFOHeader) + len;
+
+        rvfo->session->queuePacket(rvfo->buf, rvfo->pkt_hdr->size, true);
+    }
+
+    bool Session::queuePacket(const uint8_t* data, int len, bool droppable) {
+        {
+            std::lock_guard<std::mutex> lck(sendMtx);
+            if (stopSender) { return false; }
+
+            // Samples for a client that can't keep up are dropped here instead of stalling the source
+            if (droppable && queuedBytes + len > SERVER_MAX_QUEUED_BYTES) {
+                if (!droppedPackets++) { flog::warn("Client {0} is too slow, dropping data", id); }
+                totalDropped++;
+                return false;
+            }
+
+            // Reuse a buffer the send thread is done with, they keep their capacity so this doesn't allocate
+            if (freeBuffers.empty()) {
+                sendQueue.emplace_back(data, data + len);
+            }
+            else {
+                sendQueue.push_back(std::move(freeBuffers.back()));
+                freeBuffers.pop_back();
+                sendQueue.back().assign(data, data + len);
+            }
+            queuedBytes += len;
+        }
+        sendCnd.notify_one();
+        return true;
+    }
+
+    void Session::sendWorker() {
+        std::vector<uint8_t> pkt;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(sendMtx);
+                sendCnd.wait(lck, [this]() { return !sendQueue.empty() || stopSender; });
+                if (stopSender) { return; }
+                pkt = std::move(sendQueue.front());
+                sendQueue.pop_front();
+                queuedBytes -= pkt.size();
+
+                if (sendQueue.empty() && droppedPackets) {
+                    flog::warn("Client {0} caught up after {1} dropped packets", id, droppedPackets);
+                    droppedPackets = 0;
+                }
+            }
+
+            conn->write(pkt.size(), pkt.data());
+
+            // Hand the buffer back for the next packets
+            std::lock_guard<std::mutex> lck(sendMtx);
+            if (freeBuffers.size() < SERVER_MAX_FREE_BUFFERS) { freeBuffers.push_back(std::move(pkt)); }
+        }
+    }
+
+    void Session::setRunning(bool enabled) {
+        if (enabled == running) { return; }
+        running = enabled;
+
+        // The source runs as long as at least one client wants samples
+        if (running) {
+            if (!runningSessions++) { sigpath::sourceManager.start(); }
+        }
+        else {
+            if (!--runningSessions) { sigpath::sourceManager.stop(); }
+        }
+    }
+
+    void Session::setFullIQ(bool enabled) {
+        if (enabled == fullIQ) { return; }
+        fullIQ = enabled;
+        if (fullIQ) {
+            sigpath::iqFrontEnd.bindIQStream(&iqStream);
+        }
+        else {
+            // The compressor must be done with the shared baseband buffer before it's handed back
+            comp.stop();
+            sigpath::iqFrontEnd.unbindIQStream(&iqStream);
+            comp.start();
+        }
+    }
+
+    void Session::setVFO(const VFOSettings& settings) {
+        // Update the VFO if it already exists
+        auto it = vfos.find(settings.id);
+        if (it != vfos.end()) {
+            RemoteVFO* rvfo = it->second;
+            if (settings.sampleRate != rvfo->settings.sampleRate) {
+                sigpath::iqFrontEnd.setVFOSampleRate(rvfo->name, settings.sampleRate, settings.bandwidth);
+            }
+            else if (settings.bandwidth != rvfo->settings.bandwidth) {
+                sigpath::iqFrontEnd.setVFOBandwidth(rvfo->name, settings.bandwidth);
+            }
+            if (settings.offset != rvfo->settings.offset) {
+                sigpath::iqFrontEnd.setVFOOffset(rvfo->name, settings.offset);
+            }
+            rvfo->settings = settings;
+            return;
+        }
+
+        if (vfos.size() >= SERVER_MAX_VFOS) {
+            sendError(ERROR_INVALID_ARGUMENT);
+            return;
+        }
+
+        // Create the DDC and its compressor
+        std::string name = "server_vfo_" + std::to_string(id) + "_" + std::to_string(settings.id);
+        dsp::channel::RxVFO* vfo = sigpath::iqFrontEnd.addVFO(name, settings.sampleRate, settings.bandwidth, settings.offset);
+        if (!vfo) {
+            sendError(ERROR_INVALID_ARGUMENT);
+            return;
+        }
+        RemoteVFO* rvfo = new RemoteVFO;
+        rvfo->name = name;
+        rvfo->settings = settings;
+        rvfo->session = this;
+        rvfo->buf = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        rvfo->pkt_hdr = (PacketHeader*)rvfo->buf;
+        rvfo->vfo_hdr = (VFOHeader*)&rvfo->buf[sizeof(PacketHeader)];
+        rvfo->data = &rvfo->buf[sizeof(PacketHeader) + sizeof(VFOHeader)];
+        rvfo->cctx = ZSTD_createCCtx();
+        rvfo->comp.init(&vfo->out, pcmType);
+        rvfo->hnd.init(&rvfo->comp.out, _vfoHandler, rvfo);
+        vfos[settings.id] = rvfo;
+        rvfo->comp.start();
+        rvfo->hnd.start();
+    }
+
+    void Session::removeVFO(uint32_t id) {
+        auto it = vfos.find(id);
+        if (it == vfos.end()) { return; }
+        RemoteVFO* rvfo = it->second;
+        vfos.erase(it);
+
+        // Stop the compressor before the VFO it reads from goes away
+        rvfo->hnd.stop();
+        rvfo->comp.stop();
+        sigpath::iqFrontEnd.removeVFO(rvfo->name);
+        ZSTD_freeCCtx(rvfo->cctx);
+        delete[] rvfo->buf;
+        delete rvfo;
+    }
+
+    FFTSettings Session::getFFTSettings() {
+        std::lock_guard<std::mutex> lck(fftMtx);
+        return fftSettings;
+    }
+
+    void Session::pushFFT(const float* line, int size, double sampleRate, double lineRate) {
+        std::lock_guard<std::mutex> lck(fftMtx);
+        if (!fftSettings.enabled) { return; }
+
+        // The shared FFT runs at the fastest rate requested, only keep the lines this client asked for
+        fftCredit += (double)fftSettings.rate / lineRate;
+        if (fftCredit < 1.0) { return; }
+        fftCredit = std::min<double>(fftCredit - 1.0, 1.0);
+
+        // Reduce the zoom window to the requested width, keeping the highest bin merged into each point
+        int width = fftSettings.width;
+        double binWidth = sampleRate / (double)size;
+        double start = ((fftSettings.offset - (fftSettings.bandwidth / 2.0)) / binWidth) + (double)(size / 2);
+        double binsPerPoint = (fftSettings.bandwidth / binWidth) / (double)width;
+        for (int i = 0; i < width; i++) {
+            int first = floor(start + (i * binsPerPoint));
+            int last = std::max<int>(first + 1, floor(start + ((i + 1) * binsPerPoint)));
+            first = std::clamp<int>(first, 0, size);
+            last = std::clamp<int>(last, 0, size);
+            if (first >= last) {
+                fftZoom[i] = SPECTRUM_CODEC_FLOOR;
+                continue;
+            }
+            float max = line[first];
+            for (int j = first + 1; j < last; j++) { max = std::max<float>(max, line[j]); }
+            fftZoom[i] = max;
+        }
+
+        // Quantize and compress if needed
+        f_fft_hdr->offset = fftSettings.offset;
+        f_fft_hdr->bandwidth = fftSettings.bandwidth;
+        f_fft_hdr->flags = 0;
+        int len;
         if (compression) {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND_COMPRESSED;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + (uint32_t)ZSTD_compressCCtx(cctx, &bbuf[sizeof(PacketHeader)], SERVER_MAX_PACKET_SIZE-sizeof(PacketHeader), data, count, 1);
+            len = dsp::compression::encodeSpectrum(fftZoom, width, fftCodeBuf, fftSettings.deltaCoding);
+            size_t clen = ZSTD_compressCCtx(fctx, f_fft_data, SERVER_MAX_PACKET_SIZE - sizeof(PacketHeader) - sizeof(FFTHeader), fftCodeBuf, len, 1);
+            if (ZSTD_isError(clen)) { return; }
+            len = clen;
+            f_fft_hdr->flags |= FFT_FLAG_COMPRESSED;
         }
         else {
-            bb_pkt_hdr->type = PACKET_TYPE_BASEBAND;
-            bb_pkt_hdr->size = sizeof(PacketHeader) + count;
-            memcpy(&bbuf[sizeof(PacketHeader)], data, count);
+            len = dsp::compression::encodeSpectrum(fftZoom, width, f_fft_data, fftSettings.deltaCoding);
         }
 
-        // Write to network
-        if (client && client->isOpen()) { client->write(bb_pkt_hdr->size, bbuf); }
+        f_pkt_hdr->type = PACKET_TYPE_FFT;
+        f_pkt_hdr->size = sizeof(PacketHeader) + sizeof(FFTHeader) + len;
+        queuePacket(fbuf, f_pkt_hdr->size, true);
+    }
+
+    float* _fftAcquire(void* ctx) {
+        fftMtx.lock();
+        return fftEnabled ? fftLine : NULL;
+    }
+
+    void _fftRelease(void* ctx) {
+        if (fftEnabled) {
+            std::lock_guard<std::mutex> lck(sessionsMtx);
+            for (auto& session : sessions) {
+                session->pushFFT(fftLine, fftSize, sampleRate, fftRate);
+            }
+        }
+        fftMtx.unlock();
+    }
+
+    // Must be called with cmdMtx held
+    void updateFFT() {
+        // Run the shared FFT with the finest resolution and fastest rate any client asked for
+        bool enabled = false;
+        int size = SERVER_MIN_FFT_SIZE;
+        float rate = 0.0f;
+        {
+            std::lock_guard<std::mutex> lck(sessionsMtx);
+            for (auto& session : sessions) {
+                FFTSettings settings = session->getFFTSettings();
+                if (!settings.enabled) { continue; }
+                enabled = true;
+                size = std::max<int>(size, settings.size);
+                rate = std::max<float>(rate, settings.rate);
+            }
+        }
+
+        // Disable the lines before shrinking the FFT so that they're never reduced past its end
+        bool sizeChanged, rateChanged;
+        {
+            std::lock_guard<std::mutex> lck(fftMtx);
+            if (!enabled) {
+                fftEnabled = false;
+                return;
+            }
+            sizeChanged = (size != fftSize);
+            rateChanged = (rate != fftRate);
+            fftEnabled = !sizeChanged;
+        }
+
+        // Can't hold fftMtx here since reconfiguring waits for the FFT thread to stop
+        if (sizeChanged) { sigpath::iqFrontEnd.setFFTSize(size); }
+        if (rateChanged) { sigpath::iqFrontEnd.setFFTRate(rate); }
+
+        std::lock_guard<std::mutex> lck(fftMtx);
+        fftSize = size;
+        fftRate = rate;
+        fftEnabled = true;
     }
 
     void setInput(dsp::stream<dsp::complex_t>* stream) {
-        comp.setInput(stream);
+        sigpath::iqFrontEnd.setInput(stream);
     }
 
-    void commandHandler(Command cmd, uint8_t* data, int len) {
+    void Session::commandHandler(Command cmd, uint8_t* data, int len) {
         if (cmd == COMMAND_GET_UI) {
             sendUI(COMMAND_GET_UI, "", dummyElem);
         }
@@ -280,24 +629,67 @@ namespace server {
             }
         }
         else if (cmd == COMMAND_START) {
-            sigpath::sourceManager.start();
-            running = true;
+            setRunning(true);
         }
         else if (cmd == COMMAND_STOP) {
-            sigpath::sourceManager.stop();
-            running = false;
+            setRunning(false);
         }
         else if (cmd == COMMAND_SET_FREQUENCY && len == 8) {
             sigpath::sourceManager.tune(*(double*)data);
             sendCommandAck(COMMAND_SET_FREQUENCY, 0);
         }
         else if (cmd == COMMAND_SET_SAMPLE_TYPE && len == 1) {
-            dsp::compression::PCMType type = (dsp::compression::PCMType)*(uint8_t*)data;
-            comp.setPCMType(type);
+            int type = *(uint8_t*)data;
+            if (type > dsp::compression::PCM_TYPE_F32 && !dsp::compression::isBFPType(type)) {
+                sendError(ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            pcmType = (dsp::compression::PCMType)type;
+            comp.setPCMType(pcmType);
+            for (auto& [id, rvfo] : vfos) { rvfo->comp.setPCMType(pcmType); }
         }
         else if (cmd == COMMAND_SET_COMPRESSION && len == 1) {
             compression = *(uint8_t*)data;
         }
+        else if (cmd == COMMAND_SET_FFT && len == sizeof(FFTSettings)) {
+            FFTSettings settings;
+            memcpy(&settings, data, sizeof(FFTSettings));
+            bool sizeValid = (settings.size >= SERVER_MIN_FFT_SIZE && settings.size <= SERVER_MAX_FFT_SIZE && !(settings.size & (settings.size - 1)));
+            bool widthValid = (settings.width > 0 && settings.width <= SERVER_MAX_FFT_WIDTH);
+            bool rateValid = (settings.rate > 0.0f && settings.rate <= SERVER_MAX_FFT_RATE);
+            if (settings.enabled && (!sizeValid || !widthValid || !rateValid || !(settings.bandwidth > 0.0))) {
+                sendError(ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lck(fftMtx);
+                if (settings.enabled) {
+                    fftSettings = settings;
+                }
+                else {
+                    fftSettings.enabled = false;
+                }
+            }
+            updateFFT();
+        }
+        else if (cmd == COMMAND_SET_FULL_IQ && len == 1) {
+            setFullIQ(*(uint8_t*)data);
+        }
+        else if (cmd == COMMAND_SET_VFO && len == sizeof(VFOSettings)) {
+            VFOSettings settings;
+            memcpy(&settings, data, sizeof(VFOSettings));
+            // The output can't be faster than the baseband it's taken from, nor wider than its own rate
+            bool rateValid = (settings.sampleRate > 0.0 && settings.sampleRate <= sigpath::iqFrontEnd.getEffectiveSamplerate());
+            bool bandwidthValid = (settings.bandwidth > 0.0 && settings.bandwidth <= settings.sampleRate);
+            if (!rateValid || !bandwidthValid) {
+                sendError(ERROR_INVALID_ARGUMENT);
+                return;
+            }
+            setVFO(settings);
+        }
+        else if (cmd == COMMAND_REMOVE_VFO && len == sizeof(uint32_t)) {
+            removeVFO(*(uint32_t*)data);
+        }
         else {
             flog::error("Invalid Command: {0} (len = {1})", (int)cmd, len);
             sendError(ERROR_INVALID_COMMAND);
@@ -305,6 +697,7 @@ namespace server {
     }
 
     void drawMenu() {
+        bool running = (runningSessions > 0);
         if (running) { SmGui::BeginDisabled(); }
         SmGui::FillWidth();
         SmGui::ForceSync();
@@ -339,7 +732,7 @@ namespace server {
         }
     }
 
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
+    void Session::sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue) {
         // Render UI
         SmGui::DrawList dl;
         renderUI(&dl, diffId, diffValue);
@@ -352,35 +745,69 @@ namespace server {
         sendCommandAck(originCmd, size);
     }
 
-    void sendError(Error err) {
-        PacketHeader* hdr = (PacketHeader*)sbuf;
+    void Session::sendError(Error err) {
         s_pkt_data[0] = err;
         sendPacket(PACKET_TYPE_ERROR, 1);
     }
 
-    void sendSampleRate(double sampleRate) {
-        *(double*)s_cmd_data = sampleRate;
-        sendCommand(COMMAND_SET_SAMPLERATE, sizeof(double));
+    void Session::sendSampleRate(double sampleRate) {
+        // Can be called from any thread, so don't use the command buffer
+        uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(double)];
+        PacketHeader* hdr = (PacketHeader*)buf;
+        CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
+        hdr->type = PACKET_TYPE_COMMAND;
+        hdr->size = sizeof(buf);
+        chdr->cmd = COMMAND_SET_SAMPLERATE;
+        memcpy(&buf[sizeof(PacketHeader) + sizeof(CommandHeader)], &sampleRate, sizeof(double));
+        queuePacket(buf, sizeof(buf), false);
+    }
+
+    void Session::sendStats() {
+        dsp::compression::ZstdPipeline::Stats ps = pipeline.getStats();
+        uint8_t buf[sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(ServerStats)];
+        PacketHeader* hdr = (PacketHeader*)buf;
+        CommandHeader* chdr = (CommandHeader*)&buf[sizeof(PacketHeader)];
+        ServerStats stats;
+        stats.compressionRatio = ps.compressedBytes ? (float)((double)ps.rawBytes / (double)ps.compressedBytes) : 0.0f;
+        stats.compressionLevel = ps.level;
+        stats.cpuLoad = std::clamp<int>(roundf(ps.cpuLoad * 100.0f), 0, 100);
+        stats.queuedFrames = ps.queuedFrames;
+        {
+            std::lock_guard<std::mutex> lck(sendMtx);
+            stats.queuedBytes = queuedBytes;
+            stats.droppedFrames = ps.dropped + totalDropped;
+        }
+        hdr->type = PACKET_TYPE_COMMAND;
+        hdr->size = sizeof(buf);
+        chdr->cmd = COMMAND_SET_STATS;
+        memcpy(&buf[sizeof(PacketHeader) + sizeof(CommandHeader)], &stats, sizeof(ServerStats));
+        queuePacket(buf, sizeof(buf), false);
     }
 
     void setInputSampleRate(double samplerate) {
-        sampleRate = samplerate;
-        if (!client || !client->isOpen()) { return; }
-        sendSampleRate(sampleRate);
+        sigpath::iqFrontEnd.setSampleRate(samplerate);
+        {
+            std::lock_guard<std::mutex> lck(fftMtx);
+            sampleRate = samplerate;
+        }
+        std::lock_guard<std::mutex> lck(sessionsMtx);
+        for (auto& session : sessions) {
+            session->sendSampleRate(samplerate);
+        }
     }
 
-    void sendPacket(PacketType type, int len) {
+    void Session::sendPacket(PacketType type, int len) {
         s_pkt_hdr->type = type;
         s_pkt_hdr->size = sizeof(PacketHeader) + len;
-        client->write(s_pkt_hdr->size, sbuf);
+        queuePacket(sbuf, s_pkt_hdr->size, false);
     }
 
-    void sendCommand(Command cmd, int len) {
+    void Session::sendCommand(Command cmd, int len) {
         s_cmd_hdr->cmd = cmd;
         sendPacket(PACKET_TYPE_COMMAND, sizeof(CommandHeader) + len);
     }
 
-    void sendCommandAck(Command cmd, int len) {
+    void Session::sendCommandAck(Command cmd, int len) {
         s_cmd_hdr->cmd = cmd;
         sendPacket(PACKET_TYPE_COMMAND_ACK, sizeof(CommandHeader) + len);
     }
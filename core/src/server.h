@@ -2,26 +2,150 @@
 #include <utils/networking.h>
 #include <dsp/stream.h>
 #include <dsp/types.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/compression/zstd_pipeline.h>
+#include <dsp/sink/handler_sink.h>
 #include <server_protocol.h>
+#include <zstd.h>
+#include <deque>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+// Bytes of samples and spectrum lines a client can have waiting to be sent before new ones are dropped
+#define SERVER_MAX_QUEUED_BYTES     (32 * 1024 * 1024)
+
+// Bytes of baseband a client can have waiting to be compressed before new frames are dropped
+#define SERVER_MAX_PIPELINE_BYTES   (8 * 1024 * 1024)
+
+// Upper bound on the number of baseband compression threads per client
+#define SERVER_MAX_COMPRESSION_THREADS  4
+
+// Sent packet buffers kept per client for reuse by the next packets
+#define SERVER_MAX_FREE_BUFFERS     32
 
 namespace server {
+    // A connected client, with its own compressors, options and send queue
+    class Session {
+    public:
+        Session(net::Conn conn, int id);
+        ~Session();
+
+        bool isOpen();
+
+        // Called from the FFT thread with every line of the shared FFT
+        void pushFFT(const float* line, int size, double sampleRate, double lineRate);
+        FFTSettings getFFTSettings();
+
+        void sendSampleRate(double sampleRate);
+        void sendStats();
+
+    private:
+        struct RemoteVFO {
+            std::string name;
+            VFOSettings settings;
+            dsp::compression::SampleStreamCompressor comp;
+            dsp::sink::Handler<uint8_t> hnd;
+            uint8_t* buf;
+            PacketHeader* pkt_hdr;
+            VFOHeader* vfo_hdr;
+            uint8_t* data;
+            ZSTD_CCtx* cctx;
+            Session* session;
+        };
+
+        static void _packetHandler(int count, uint8_t* buf, void* ctx);
+        static void _basebandHandler(uint8_t* data, int count, void* ctx);
+        static void _compressedHandler(uint8_t* buf, int len, bool compressed, void* ctx);
+        static void _vfoHandler(uint8_t* data, int count, void* ctx);
+
+        void commandHandler(Command cmd, uint8_t* data, int len);
+        void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
+        void sendError(Error err);
+
+        void sendPacket(PacketType type, int len);
+        void sendCommand(Command cmd, int len);
+        void sendCommandAck(Command cmd, int len);
+
+        // Queue a complete packet for sending, droppable packets are discarded if the client is too far behind
+        bool queuePacket(const uint8_t* data, int len, bool droppable);
+        void sendWorker();
+
+        void setRunning(bool enabled);
+        void setFullIQ(bool enabled);
+        void setVFO(const VFOSettings& settings);
+        void removeVFO(uint32_t id);
+
+        int id;
+        net::Conn conn;
+
+        // Set when the client sent something invalid, the main loop then removes the session
+        std::atomic<bool> dropClient = false;
+
+        uint8_t* rbuf = NULL;
+        uint8_t* sbuf = NULL;
+        uint8_t* fbuf = NULL;
+
+        PacketHeader* r_pkt_hdr = NULL;
+        uint8_t* r_pkt_data = NULL;
+        PacketHeader* s_pkt_hdr = NULL;
+        uint8_t* s_pkt_data = NULL;
+        CommandHeader* s_cmd_hdr = NULL;
+        uint8_t* s_cmd_data = NULL;
+        PacketHeader* f_pkt_hdr = NULL;
+        FFTHeader* f_fft_hdr = NULL;
+        uint8_t* f_fft_data = NULL;
+
+        // Options
+        bool running = false;
+        bool compression = false;
+        bool fullIQ = false;
+        dsp::compression::PCMType pcmType = dsp::compression::PCM_TYPE_I16;
+
+        // Baseband
+        dsp::stream<dsp::complex_t> iqStream;
+        dsp::compression::SampleStreamCompressor comp;
+        dsp::sink::Handler<uint8_t> hnd;
+        dsp::compression::ZstdPipeline pipeline;
+
+        // VFOs
+        std::map<uint32_t, RemoteVFO*> vfos;
+
+        // FFT
+        std::mutex fftMtx;
+        FFTSettings fftSettings = {};
+        double fftCredit = 0.0;
+        float* fftZoom = NULL;
+        uint8_t* fftCodeBuf = NULL;
+        ZSTD_CCtx* fctx;
+
+        // Send queue
+        std::mutex sendMtx;
+        std::condition_variable sendCnd;
+        std::deque<std::vector<uint8_t>> sendQueue;
+        std::vector<std::vector<uint8_t>> freeBuffers;
+        int queuedBytes = 0;
+        int droppedPackets = 0;
+        uint64_t totalDropped = 0;
+        bool stopSender = false;
+        std::thread sendThread;
+    };
+
     void setInput(dsp::stream<dsp::complex_t>* stream);
     int main();
 
     void _clientHandler(net::Conn conn, void* ctx);
-    void _packetHandler(int count, uint8_t* buf, void* ctx);
-    void _testServerHandler(uint8_t* data, int count, void* ctx);
+    float* _fftAcquire(void* ctx);
+    void _fftRelease(void* ctx);
 
     void drawMenu();
-
-    void commandHandler(Command cmd, uint8_t* data, int len);
     void renderUI(SmGui::DrawList* dl, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendUI(Command originCmd, std::string diffId, SmGui::DrawListElem diffValue);
-    void sendError(Error err);
-    void sendSampleRate(double sampleRate);
-    void setInputSampleRate(double samplerate);
 
-    void sendPacket(PacketType type, int len);
-    void sendCommand(Command cmd, int len);
-    void sendCommandAck(Command cmd, int len);
+    void setInputSampleRate(double samplerate);
+    void updateFFT();
+    void removeClosedSessions();
+    void broadcastStats();
 }
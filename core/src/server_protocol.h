@@ -5,6 +5,15 @@
 
 #define SERVER_MAX_PACKET_SIZE  (STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) * 2)
 
+// Limits on the FFT a client can ask the server to compute and on the width of the lines it sends back
+#define SERVER_MAX_FFT_SIZE     524288
+#define SERVER_MIN_FFT_SIZE     1024
+#define SERVER_MAX_FFT_WIDTH    16384
+#define SERVER_MAX_FFT_RATE     200.0f
+
+// Maximum number of VFOs a client can run on the server
+#define SERVER_MAX_VFOS         64
+
 namespace server {
     enum PacketType {
         // Client to Server
@@ -27,10 +36,15 @@ namespace server {
         COMMAND_GET_SAMPLERATE,
         COMMAND_SET_SAMPLE_TYPE,
         COMMAND_SET_COMPRESSION,
+        COMMAND_SET_FFT,
+        COMMAND_SET_FULL_IQ,
+        COMMAND_SET_VFO,
+        COMMAND_REMOVE_VFO,
 
         // Server to client
         COMMAND_SET_SAMPLERATE = 0x80,
-        COMMAND_DISCONNECT
+        COMMAND_DISCONNECT,
+        COMMAND_SET_STATS
     };
 
     enum Error {
@@ -39,6 +53,14 @@ namespace server {
         ERROR_INVALID_COMMAND,
         ERROR_INVALID_ARGUMENT
     };
+
+    enum FFTFlags {
+        FFT_FLAG_COMPRESSED = (1 << 0)
+    };
+
+    enum VFOFlags {
+        VFO_FLAG_COMPRESSED = (1 << 0)
+    };
     
 #pragma pack(push, 1)
     struct PacketHeader {
@@ -49,5 +71,47 @@ namespace server {
     struct CommandHeader {
         uint32_t cmd;
     };
+
+    // Argument of COMMAND_SET_FFT
+    struct FFTSettings {
+        uint8_t enabled;
+        uint8_t deltaCoding;
+        uint16_t width;     // Bins per line sent to the client
+        uint32_t size;      // Size of the FFT computed by the server
+        float rate;         // Lines per second
+        double offset;      // Center of the zoom window relative to the tuned frequency
+        double bandwidth;   // Width of the zoom window
+    };
+
+    // Argument of COMMAND_SET_VFO, creates the VFO if no VFO has that ID yet. COMMAND_REMOVE_VFO only takes the ID.
+    struct VFOSettings {
+        uint32_t id;
+        double offset;      // Relative to the tuned frequency
+        double sampleRate;
+        double bandwidth;
+    };
+
+    // Start of a PACKET_TYPE_VFO packet, followed by the VFO's samples in the same format as the baseband
+    struct VFOHeader {
+        uint32_t id;
+        uint8_t flags;
+    };
+
+    // Start of a PACKET_TYPE_FFT packet, followed by a line coded with dsp::compression::encodeSpectrum()
+    struct FFTHeader {
+        double offset;
+        double bandwidth;
+        uint8_t flags;
+    };
+
+    // Argument of COMMAND_SET_STATS, sent by the server about once per second
+    struct ServerStats {
+        float compressionRatio; // Raw over compressed size of the baseband, 0 if nothing was compressed
+        int8_t compressionLevel;
+        uint8_t cpuLoad;        // Percent of the compression threads' time spent compressing
+        uint32_t queuedFrames;  // Baseband frames waiting to be compressed
+        uint32_t queuedBytes;   // Bytes waiting to be sent
+        uint32_t droppedFrames; // Total dropped by the compression pipeline and the send queue
+    };
 #pragma pack(pop)
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "iq_frontend.h"
+#include "signal_path.h"
 #include "../dsp/window/blackman.h"
 #include "../dsp/window/nuttall.h"
 #include <utils/flog.h>
@@ -9,9 +10,10 @@ IQFrontEnd::~IQFrontEnd() {
     if (!_init) { return; }
     stop();
     dsp::buffer::free(fftWindowBuf);
-    fftwf_destroy_plan(fftwPlan);
     fftwf_free(fftInBuf);
     fftwf_free(fftOutBuf);
+    welchFrames = 1;
+    updateWelchPlans();
 }
 
 void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool buffering, int decimRatio, bool dcBlocking, int fftSize, double fftRate, FFTWindow fftWindow, float* (*acquireFFTBuffer)(void* ctx), void (*releaseFFTBuffer)(void* ctx), void* fftCtx) {
@@ -30,6 +32,9 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     inBuf.bypass = !buffering;
 
     decim.init(NULL, _decimRatio);
+
+    // Split very large blocks between the DSP workers when decimating high samplerates
+    decim.setWorkerPool(&sigpath::dspPool);
     dcBlock.init(NULL, genDCBlockRate(effectiveSr));
     conjugate.init(NULL);
 
@@ -38,8 +43,18 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     preproc.addBlock(&dcBlock, dcBlocking);
     preproc.addBlock(&conjugate, false); // TODO: Replace by parameter
 
+    // Run the whole pre-processing chain on a single thread
+    preproc.setFused(true, [](dsp::stream<dsp::complex_t>* out){});
+
+    // The full rate streams have a single reader and writer, so they can use the lock-free ring transport
+    inBuf.out.setRingMode(IQFRONTEND_RING_SLOTS);
+    preproc.setRingMode(IQFRONTEND_RING_SLOTS);
+
     split.init(preproc.out);
 
+    // Hand the same buffer to every VFO and the FFT instead of copying it for each of them
+    split.setBroadcast(true);
+
     // TODO: Do something to avoid basically repeating this code twice
     int skip;
     genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
@@ -59,13 +74,16 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftwPlan = dsp::fft::planCache.dft(_fftSize, (dsp::complex_t*)fftInBuf, (dsp::complex_t*)fftOutBuf, FFTW_FORWARD);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
 
     split.bindStream(&fftIn);
 
+    // The channelizer is only bound to the splitter once enabled
+    channelizer.init(&chanIn, IQFRONTEND_DEFAULT_CHANNELS);
+
     _init = true;
 }
 
@@ -80,12 +98,15 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
         vfo->tempStop();
     }
 
-    // Update the samplerate
+    // Update the samplerate, channelized VFOs are updated once the blocks are restarted
     _sampleRate = sampleRate;
     effectiveSr = _sampleRate / _decimRatio;
     dcBlock.setRate(genDCBlockRate(effectiveSr));
     for (auto& [name, vfo] : vfos) {
+        VFOParams& params = vfoParams[name];
+        if (params.channel >= 0) { continue; }
         vfo->setInSamplerate(effectiveSr);
+        params.inSamplerate = effectiveSr;
     }
 
     // Reconfigure the FFT
@@ -96,10 +117,15 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
     for (auto& [name, vfo] : vfos) {
         vfo->tempStart();
     }
+
+    // The channel spacing changed, re-evaluate which channel feeds each VFO
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name);
+    }
 }
 
 void IQFrontEnd::setBuffering(bool enabled) {
-    inBuf.bypass = !enabled;
+    inBuf.setBypass(!enabled);
 }
 
 void IQFrontEnd::setDecimation(int ratio) {
@@ -148,14 +174,22 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
     dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
 
+    // Run the VFO on the shared DSP pool so that many VFOs don't each need their own thread
+    vfo->setScheduler(&sigpath::dspPool);
+
     // Register them
     vfoStreams[name] = vfoIn;
     vfos[name] = vfo;
+    vfoParams[name] = { offset, bandwidth, -1, effectiveSr, sampleRate };
     bindIQStream(vfoIn);
 
+    // Move it to a channelizer output if it fits in one
+    routeVFO(name);
+
     // Start VFO
     vfo->start();
 
+    onVFOChange.emit(name);
     return vfo;
 }
 
@@ -166,6 +200,8 @@ void IQFrontEnd::removeVFO(std::string name) {
         return;
     }
 
+    onVFORemove.emit(name);
+
     // Remove the VFO and stream from registry
     dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
     dsp::channel::RxVFO* vfo = vfos[name];
@@ -173,15 +209,103 @@ void IQFrontEnd::removeVFO(std::string name) {
     // Stop the VFO
     vfo->stop();
 
-    unbindIQStream(vfoIn);
+    if (vfoParams[name].channel < 0) {
+        unbindIQStream(vfoIn);
+    }
+    else {
+        channelizer.unbindStream(vfoIn);
+    }
     vfoStreams.erase(name);
     vfos.erase(name);
+    vfoParams.erase(name);
 
     // Delete the VFO and its input stream
     delete vfo;
     delete vfoIn;
 }
 
+void IQFrontEnd::setVFOOffset(std::string name, double offset) {
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to tune a VFO that doesn't exist.");
+        return;
+    }
+    vfoParams[name].offset = offset;
+    routeVFO(name);
+    onVFOChange.emit(name);
+}
+
+void IQFrontEnd::setVFOBandwidth(std::string name, double bandwidth) {
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to change the bandwidth of a VFO that doesn't exist.");
+        return;
+    }
+    vfos[name]->setBandwidth(bandwidth);
+    vfoParams[name].bandwidth = bandwidth;
+    routeVFO(name);
+    onVFOChange.emit(name);
+}
+
+void IQFrontEnd::setVFOSampleRate(std::string name, double sampleRate, double bandwidth) {
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to change the samplerate of a VFO that doesn't exist.");
+        return;
+    }
+    vfos[name]->setOutSamplerate(sampleRate, bandwidth);
+    vfoParams[name].bandwidth = bandwidth;
+    vfoParams[name].outSamplerate = sampleRate;
+    routeVFO(name);
+    onVFOChange.emit(name);
+}
+
+bool IQFrontEnd::getVFOParams(const std::string& name, double& offset, double& sampleRate, double& bandwidth) {
+    auto it = vfoParams.find(name);
+    if (it == vfoParams.end()) { return false; }
+    offset = it->second.offset;
+    sampleRate = it->second.outSamplerate;
+    bandwidth = it->second.bandwidth;
+    return true;
+}
+
+dsp::stream<dsp::complex_t>* IQFrontEnd::getVFOOutput(const std::string& name) {
+    auto it = vfos.find(name);
+    if (it == vfos.end()) { return NULL; }
+    return &it->second->out;
+}
+
+std::vector<std::string> IQFrontEnd::getVFONames() {
+    std::vector<std::string> names;
+    for (auto& [name, vfo] : vfos) { names.push_back(name); }
+    return names;
+}
+
+void IQFrontEnd::setChannelizer(int channels) {
+    if (channels == _channels) { return; }
+
+    // Feed every VFO from the full band while the channelizer is reconfigured
+    int oldChannels = _channels;
+    _channels = 0;
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name);
+    }
+
+    // Only keep the channelizer connected when it's in use
+    if (oldChannels) {
+        channelizer.stop();
+        split.unbindStream(&chanIn);
+    }
+    if (channels) {
+        channelizer.setChannelCount(channels);
+        split.bindStream(&chanIn);
+        if (running) { channelizer.start(); }
+    }
+    _channels = channels;
+
+    // Move the VFOs that fit to their channel
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name);
+    }
+}
+
 void IQFrontEnd::setFFTSize(int size) {
     _fftSize = size;
     updateFFTPath(true);
@@ -197,6 +321,11 @@ void IQFrontEnd::setFFTWindow(FFTWindow fftWindow) {
     updateFFTPath();
 }
 
+void IQFrontEnd::setFFTAveraging(bool enabled) {
+    _fftAveraging = enabled;
+    updateFFTPath();
+}
+
 void IQFrontEnd::flushInputBuffer() {
     inBuf.flush();
 }
@@ -211,6 +340,9 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
+    // Start channelizer if enabled
+    if (_channels) { channelizer.start(); }
+
     // Start all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->start();
@@ -219,6 +351,8 @@ void IQFrontEnd::start() {
     // Start FFT chain
     reshape.start();
     fftSink.start();
+
+    running = true;
 }
 
 void IQFrontEnd::stop() {
@@ -231,6 +365,9 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
+    // Stop channelizer
+    channelizer.stop();
+
     // Stop all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
@@ -239,20 +376,96 @@ void IQFrontEnd::stop() {
     // Stop FFT chain
     reshape.stop();
     fftSink.stop();
+
+    running = false;
 }
 
 double IQFrontEnd::getEffectiveSamplerate() {
     return effectiveSr;
 }
 
+void IQFrontEnd::routeVFO(const std::string& name) {
+    VFOParams& params = vfoParams[name];
+    dsp::channel::RxVFO* vfo = vfos[name];
+
+    // Pick the channel feeding the VFO, or the full band if none is wide enough
+    int channel = selectChannel(params.offset, params.bandwidth, params.channel);
+    bool move = (channel != params.channel);
+
+    // Switch to the new source if needed
+    if (move) {
+        dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
+        vfo->tempStop();
+        if (params.channel < 0) {
+            unbindIQStream(vfoIn);
+        }
+        else {
+            channelizer.unbindStream(vfoIn);
+        }
+
+        // Drop anything left by the old source, it's at the wrong samplerate
+        vfoIn->flush();
+
+        if (channel < 0) {
+            bindIQStream(vfoIn);
+        }
+        else {
+            channelizer.bindStream(channel, vfoIn);
+        }
+        params.channel = channel;
+    }
+
+    // Tune the VFO relative to its source
+    double inSamplerate = (channel < 0) ? effectiveSr : (2.0 * effectiveSr / (double)_channels);
+    if (inSamplerate != params.inSamplerate) {
+        vfo->setInSamplerate(inSamplerate);
+        params.inSamplerate = inSamplerate;
+    }
+    vfo->setOffset((channel < 0) ? params.offset : (params.offset - channelOffset(channel)));
+
+    if (move) { vfo->tempStart(); }
+}
+
+int IQFrontEnd::selectChannel(double offset, double bandwidth, int current) {
+    if (!_channels) { return -1; }
+
+    // Stick to the current channel as long as the VFO fits to avoid switching back and forth at the edges
+    if (current >= 0 && fitsChannel(offset, bandwidth, current)) { return current; }
+
+    // Otherwise, use the closest channel, excluding the one at nyquist that's cut in half
+    int channel = round(offset * (double)_channels / effectiveSr);
+    if (abs(channel) >= _channels / 2) { return -1; }
+    channel = (channel + _channels) % _channels;
+    return fitsChannel(offset, bandwidth, channel) ? channel : -1;
+}
+
+bool IQFrontEnd::fitsChannel(double offset, double bandwidth, int channel) {
+    double spacing = effectiveSr / (double)_channels;
+    return (fabs(offset - channelOffset(channel)) + (bandwidth / 2.0)) <= (spacing * CHANNELIZER_PASSBAND);
+}
+
+double IQFrontEnd::channelOffset(int channel) {
+    int id = (channel < _channels / 2) ? channel : (channel - _channels);
+    return (double)id * effectiveSr / (double)_channels;
+}
+
 void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
     IQFrontEnd* _this = (IQFrontEnd*)ctx;
 
+    // Averaged path, the waterfall's buffer is only held for the conversion to dB
+    if (_this->welchFrames > 1) {
+        _this->welchFFT(data);
+        float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
+        if (fftBuf) { _this->welchToDB(fftBuf); }
+        _this->_releaseFFTBuffer(_this->_fftCtx);
+        return;
+    }
+
     // Apply window
     volk_32fc_32f_multiply_32fc((lv_32fc_t*)_this->fftInBuf, (lv_32fc_t*)data, _this->fftWindowBuf, _this->_nzFFTSize);
 
     // Execute FFT
-    fftwf_execute(_this->fftwPlan);
+    fftwf_execute_dft(_this->fftwPlan, _this->fftInBuf, _this->fftOutBuf);
 
     // Aquire buffer
     float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
@@ -266,16 +479,84 @@ void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
     _this->_releaseFFTBuffer(_this->_fftCtx);
 }
 
+void IQFrontEnd::welchFFT(dsp::complex_t* data) {
+    // Window and transform each batch of frames on a worker, summing the power of its frames
+    int hop = _fftSize / 2;
+    sigpath::dspPool.parallelFor(welchBatches, [=](int batch) {
+        int first = batch * welchBatchSize;
+        int count = std::min<int>(welchBatchSize, welchFrames - first);
+        fftwf_complex* in = &welchIn[first * _fftSize];
+        fftwf_complex* fftOut = &welchOut[first * _fftSize];
+        for (int i = 0; i < count; i++) {
+            volk_32fc_32f_multiply_32fc((lv_32fc_t*)&in[i * _fftSize], (lv_32fc_t*)&data[(first + i) * hop], fftWindowBuf, _fftSize);
+        }
+        fftwf_execute_dft((count == welchBatchSize) ? welchPlan : welchTailPlan, in, fftOut);
+
+        float* power = &welchPower[batch * _fftSize];
+        float* temp = &welchTemp[batch * _fftSize];
+        volk_32fc_magnitude_squared_32f(power, (lv_32fc_t*)fftOut, _fftSize);
+        for (int i = 1; i < count; i++) {
+            volk_32fc_magnitude_squared_32f(temp, (lv_32fc_t*)&fftOut[i * _fftSize], _fftSize);
+            volk_32f_x2_add_32f(power, power, temp, _fftSize);
+        }
+    });
+
+    // Sum the batches
+    for (int i = 1; i < welchBatches; i++) {
+        volk_32f_x2_add_32f(welchPower, welchPower, &welchPower[i * _fftSize], _fftSize);
+    }
+}
+
+void IQFrontEnd::welchToDB(float* out) {
+    // Convert the average power to dB with the same scale as the single frame path
+    float offset = -10.0f * log10f((float)welchFrames) - 20.0f * log10f((float)_fftSize);
+    for (int i = 0; i < _fftSize; i++) {
+        out[i] = 10.0f * log10f(welchPower[i]) + offset;
+    }
+}
+
+void IQFrontEnd::updateWelchPlans() {
+    // Free the previous batches
+    if (welchIn) {
+        fftwf_free(welchIn);
+        fftwf_free(welchOut);
+        dsp::buffer::free(welchPower);
+        dsp::buffer::free(welchTemp);
+        welchIn = NULL;
+        welchTailPlan = NULL;
+    }
+    if (welchFrames <= 1) { return; }
+
+    // One batch per worker, the last one gets whatever frames are left
+    sigpath::dspPool.init();
+    int threads = std::max<int>(1, sigpath::dspPool.getThreadCount());
+    welchBatchSize = (welchFrames + threads - 1) / threads;
+    welchBatches = (welchFrames + welchBatchSize - 1) / welchBatchSize;
+    int tailSize = welchFrames - ((welchBatches - 1) * welchBatchSize);
+
+    welchIn = (fftwf_complex*)fftwf_malloc(welchFrames * _fftSize * sizeof(fftwf_complex));
+    welchOut = (fftwf_complex*)fftwf_malloc(welchFrames * _fftSize * sizeof(fftwf_complex));
+    welchPower = dsp::buffer::alloc<float>(welchBatches * _fftSize);
+    welchTemp = dsp::buffer::alloc<float>(welchBatches * _fftSize);
+
+    welchPlan = dsp::fft::planCache.dft(_fftSize, (dsp::complex_t*)welchIn, (dsp::complex_t*)welchOut, FFTW_FORWARD, welchBatchSize);
+    if (tailSize != welchBatchSize) {
+        welchTailPlan = dsp::fft::planCache.dft(_fftSize, (dsp::complex_t*)welchIn, (dsp::complex_t*)welchOut, FFTW_FORWARD, tailSize);
+    }
+}
+
 void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
     // Temp stop branch
     reshape.tempStop();
     fftSink.tempStop();
 
-    // Update reshaper settings
+    // Update reshaper settings, when averaging, each block holds all the overlapping frames of a line
     int skip;
     genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
-    reshape.setKeep(_nzFFTSize);
-    reshape.setSkip(skip);
+    welchFrames = _fftAveraging ? genWelchFrames(effectiveSr, _fftSize, _fftRate) : 1;
+    int keep = _nzFFTSize + ((welchFrames - 1) * (_fftSize / 2));
+    reshape.setKeep(keep);
+    reshape.setSkip(skip - (keep - _nzFFTSize));
 
     // Update window
     dsp::buffer::free(fftWindowBuf);
@@ -295,13 +576,16 @@ void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
     fftwf_free(fftOutBuf);
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftwPlan = dsp::fft::planCache.dft(_fftSize, (dsp::complex_t*)fftInBuf, (dsp::complex_t*)fftOutBuf, FFTW_FORWARD);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
 
+    // Update the batched plans used for averaging
+    updateWelchPlans();
+
     // Update waterfall (TODO: This is annoying, it makes this module non testable and will constantly clear the waterfall for any reason)
-    if (updateWaterfall) { gui::waterfall.setRawFFTSize(_fftSize); }
+    if (updateWaterfall && !core::args["server"].b()) { gui::waterfall.setRawFFTSize(_fftSize); }
 
     // Restart branch
     reshape.tempStart();
@@ -6,9 +6,22 @@
 #include "../dsp/chain.h"
 #include "../dsp/routing/splitter.h"
 #include "../dsp/channel/rx_vfo.h"
+#include "../dsp/channel/channelizer.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/math/conjugate.h"
-#include <fftw3.h>
+#include "../dsp/fft/plan_cache.h"
+#include <utils/event.h>
+
+// Channel count the channelizer is initialized with, it's only used once enabled with setChannelizer()
+#define IQFRONTEND_DEFAULT_CHANNELS 64
+
+// Number of buffers the streams carrying the full rate IQ can queue, letting the source run ahead of the pre-processing
+#define IQFRONTEND_RING_SLOTS 3
+
+// Limits on the number of overlapped frames averaged into one FFT line and on the samples transformed per line.
+// All the samples of a line go through the reshaper at once, so they must fit both its ring and its output stream.
+#define IQFRONTEND_WELCH_MAX_FRAMES     64
+#define IQFRONTEND_WELCH_MAX_SAMPLES    std::min<int>(STREAM_BUFFER_SIZE, RING_BUF_SZ)
 
 class IQFrontEnd {
 public:
@@ -37,10 +50,28 @@ public:
     dsp::channel::RxVFO* addVFO(std::string name, double sampleRate, double bandwidth, double offset);
     void removeVFO(std::string name);
 
+    // VFO settings go through the front end since they decide which channelizer output feeds the VFO
+    void setVFOOffset(std::string name, double offset);
+    void setVFOBandwidth(std::string name, double bandwidth);
+    void setVFOSampleRate(std::string name, double sampleRate, double bandwidth);
+
+    // Returns false if the VFO doesn't exist
+    bool getVFOParams(const std::string& name, double& offset, double& sampleRate, double& bandwidth);
+    dsp::stream<dsp::complex_t>* getVFOOutput(const std::string& name);
+    std::vector<std::string> getVFONames();
+
+    // Feed narrow VFOs from a polyphase channelizer with that many channels instead of the full band, 0 to disable
+    void setChannelizer(int channels);
+
     void setFFTSize(int size);
+    inline int getFFTSize() { return _fftSize; }
     void setFFTRate(double rate);
+    inline double getFFTRate() { return _fftRate; }
     void setFFTWindow(FFTWindow fftWindow);
 
+    // Average the power of half-overlapping frames covering all samples between two FFT lines instead of using a single frame
+    void setFFTAveraging(bool enabled);
+
     void flushInputBuffer();
 
     void start();
@@ -48,9 +79,29 @@ public:
 
     double getEffectiveSamplerate();
 
+    // Emitted with the VFO's name once it's created or any of its parameters change, and right before it's removed
+    Event<std::string> onVFOChange;
+    Event<std::string> onVFORemove;
+
 protected:
     static void handler(dsp::complex_t* data, int count, void* ctx);
     void updateFFTPath(bool updateWaterfall = false);
+    void updateWelchPlans();
+    void welchFFT(dsp::complex_t* data);
+    void welchToDB(float* out);
+
+    struct VFOParams {
+        double offset;
+        double bandwidth;
+        int channel; // -1 when fed from the full band
+        double inSamplerate;
+        double outSamplerate;
+    };
+
+    void routeVFO(const std::string& name);
+    int selectChannel(double offset, double bandwidth, int current);
+    bool fitsChannel(double offset, double bandwidth, int channel);
+    double channelOffset(int channel);
 
     static inline double genDCBlockRate(double sampleRate) {
         return 50.0 / sampleRate;
@@ -62,6 +113,16 @@ protected:
         skip = fftInterval - nzSampCount;
     }
 
+    static inline int genWelchFrames(double sampleRate, int size, double rate) {
+        int fftInterval = round(sampleRate / rate);
+        int frames = ((fftInterval - size) / (size / 2)) + 1;
+
+        // A line of N frames spans size + (N - 1) * size / 2 samples
+        if (size >= IQFRONTEND_WELCH_MAX_SAMPLES) { return 1; }
+        int maxFrames = ((IQFRONTEND_WELCH_MAX_SAMPLES - size) / (size / 2)) + 1;
+        return std::clamp<int>(frames, 1, std::min<int>(IQFRONTEND_WELCH_MAX_FRAMES, maxFrames));
+    }
+
     // Input buffer
     dsp::buffer::SampleFrameBuffer<dsp::complex_t> inBuf;
 
@@ -79,9 +140,15 @@ protected:
     dsp::buffer::Reshaper<dsp::complex_t> reshape;
     dsp::sink::Handler<dsp::complex_t> fftSink;
 
+    // Channelizer
+    dsp::stream<dsp::complex_t> chanIn;
+    dsp::channel::Channelizer channelizer;
+    int _channels = 0;
+
     // VFOs
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
+    std::map<std::string, VFOParams> vfoParams;
 
     // Parameters
     double _sampleRate;
@@ -89,6 +156,7 @@ protected:
     int _fftSize;
     double _fftRate;
     FFTWindow _fftWindow;
+    bool _fftAveraging = false;
     float* (*_acquireFFTBuffer)(void* ctx);
     void (*_releaseFFTBuffer)(void* ctx);
     void* _fftCtx;
@@ -100,8 +168,20 @@ protected:
     fftwf_plan fftwPlan;
     float* fftDbOut;
 
+    // Averaging data, the frames are split in batches that each go through one plan on a DSP worker
+    int welchFrames = 1;
+    int welchBatchSize;
+    int welchBatches;
+    fftwf_complex* welchIn = NULL;
+    fftwf_complex* welchOut = NULL;
+    float* welchPower;
+    float* welchTemp;
+    fftwf_plan welchPlan;
+    fftwf_plan welchTailPlan = NULL;
+
     double effectiveSr;
 
+    bool running = false;
     bool _init = false;
 
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <signal_path/signal_path.h>
 
 namespace sigpath {
+    dsp::sched::Pool dspPool;
     IQFrontEnd iqFrontEnd;
     VFOManager vfoManager;
     SourceManager sourceManager;
@@ -6,6 +6,7 @@
 #include <module.h>
 
 namespace sigpath {
+    SDRPP_EXPORT dsp::sched::Pool dspPool;
     SDRPP_EXPORT IQFrontEnd iqFrontEnd;
     SDRPP_EXPORT VFOManager vfoManager;
     SDRPP_EXPORT SourceManager sourceManager;
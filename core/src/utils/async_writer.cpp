@@ -0,0 +1,286 @@
+#include "async_writer.h"
+#include <string.h>
+#include <algorithm>
+#include <utils/flog.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+// Alignment of the blocks in memory and on disk, required by O_DIRECT
+#define ASYNC_WRITER_ALIGNMENT      4096
+
+// Smallest amount of disk space reserved at once when preallocating
+#define ASYNC_WRITER_PREALLOC_STEP  (64 * 1024 * 1024)
+
+namespace diskio {
+    AsyncWriter::~AsyncWriter() {
+        close();
+    }
+
+    bool AsyncWriter::open(std::string path, const Options& options) {
+        close();
+        std::lock_guard<std::mutex> lck(mtx);
+
+        // Round the block size up to the alignment and have at least two blocks so that one can fill while the other is written
+        opts = options;
+        opts.blockSize = std::max<size_t>(opts.blockSize, ASYNC_WRITER_ALIGNMENT);
+        opts.blockSize = ((opts.blockSize + ASYNC_WRITER_ALIGNMENT - 1) / ASYNC_WRITER_ALIGNMENT) * ASYNC_WRITER_ALIGNMENT;
+        size_t count = std::max<size_t>((opts.bufferSize + opts.blockSize - 1) / opts.blockSize, 2);
+
+        // Open the file, falling back to buffered IO if the filesystem doesn't support direct IO
+#ifdef _WIN32
+        direct = false;
+        fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        direct = false;
+        fd = -1;
+#ifdef __linux__
+        if (opts.directIO) {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+            direct = (fd >= 0);
+            if (!direct) { flog::warn("Could not open '{0}' for direct IO, using buffered IO instead", path); }
+        }
+#endif
+        if (fd < 0) { fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); }
+#endif
+        if (fd < 0) { return false; }
+
+        // Allocate the whole pool now so that nothing is allocated while recording
+        for (size_t i = 0; i < count; i++) {
+            uint8_t* alloc = new uint8_t[opts.blockSize + ASYNC_WRITER_ALIGNMENT - 1];
+            allocations.push_back(alloc);
+            freeBlocks.push_back((uint8_t*)((((uintptr_t)alloc) + ASYNC_WRITER_ALIGNMENT - 1) & ~(uintptr_t)(ASYNC_WRITER_ALIGNMENT - 1)));
+        }
+
+        // Reset state
+        current = { NULL, 0, 0 };
+        position = 0;
+        preallocated = 0;
+        writingLen = 0;
+        stats = Stats();
+        stats.bufferSize = count * opts.blockSize;
+
+        stopWorker = false;
+        workerThread = std::thread(&AsyncWriter::worker, this);
+
+        return true;
+    }
+
+    bool AsyncWriter::isOpen() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return fd >= 0;
+    }
+
+    void AsyncWriter::close() {
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (fd < 0) { return; }
+
+            // Hand over the last partial block and let the worker finish the queue
+            submitCurrent();
+            stopWorker = true;
+        }
+        queueCnd.notify_all();
+        if (workerThread.joinable()) { workerThread.join(); }
+
+        std::lock_guard<std::mutex> lck(mtx);
+
+#ifdef __linux__
+        // Release the space that was reserved past the end of the data
+        if (preallocated > position) {
+            if (ftruncate(fd, position)) { flog::warn("Could not release the preallocated space of a file"); }
+        }
+#endif
+
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+
+        // Free the pool
+        for (auto& alloc : allocations) { delete[] alloc; }
+        allocations.clear();
+        freeBlocks.clear();
+        current = { NULL, 0, 0 };
+    }
+
+    bool AsyncWriter::write(const void* data, size_t len) {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (fd < 0) { return false; }
+
+        // Drop the whole write if it doesn't fit in the pool
+        size_t space = freeBlocks.size() * opts.blockSize;
+        if (current.data) { space += opts.blockSize - current.len; }
+        if (len > space) {
+            stats.overruns++;
+            stats.droppedBytes += len;
+            return false;
+        }
+
+        const uint8_t* in = (const uint8_t*)data;
+        while (len) {
+            // Start a new block if needed
+            if (!current.data) {
+                current.data = freeBlocks.back();
+                current.len = 0;
+                current.offset = position;
+                freeBlocks.pop_back();
+            }
+
+            size_t n = std::min<size_t>(opts.blockSize - current.len, len);
+            memcpy(&current.data[current.len], in, n);
+            current.len += n;
+            position += n;
+            in += n;
+            len -= n;
+
+            if (current.len == opts.blockSize) { submitCurrent(); }
+        }
+
+        return true;
+    }
+
+    bool AsyncWriter::writeAt(uint64_t pos, const void* data, size_t len) {
+        std::unique_lock<std::mutex> lck(mtx);
+        if (fd < 0 || pos + len > position) { return false; }
+        const uint8_t* in = (const uint8_t*)data;
+
+        // If it's all still in the block being filled, just patch it
+        if (current.data && pos >= current.offset) {
+            memcpy(&current.data[pos - current.offset], in, len);
+            return true;
+        }
+
+        // Otherwise wait for everything queued to be on disk and write the part that's there directly
+        drainCnd.wait(lck, [this]() { return queue.empty() && !writingLen; });
+        uint64_t diskEnd = current.data ? current.offset : position;
+        if (pos < diskEnd) {
+            size_t n = std::min<uint64_t>(len, diskEnd - pos);
+            disableDirectIO();
+            if (!writeFile(pos, in, n)) {
+                stats.error = true;
+                return false;
+            }
+            pos += n;
+            in += n;
+            len -= n;
+        }
+        if (len) { memcpy(&current.data[pos - current.offset], in, len); }
+
+        return true;
+    }
+
+    uint64_t AsyncWriter::tell() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return position;
+    }
+
+    Stats AsyncWriter::getStats() {
+        std::lock_guard<std::mutex> lck(mtx);
+        Stats s = stats;
+        s.bufferedBytes = writingLen + (current.data ? current.len : 0);
+        for (const auto& blk : queue) { s.bufferedBytes += blk.len; }
+        return s;
+    }
+
+    // Must be called with mtx held
+    void AsyncWriter::submitCurrent() {
+        if (!current.data) { return; }
+        if (!current.len) {
+            freeBlocks.push_back(current.data);
+            current.data = NULL;
+            return;
+        }
+        current.filled = std::chrono::steady_clock::now();
+        queue.push_back(current);
+        current.data = NULL;
+        queueCnd.notify_one();
+    }
+
+    void AsyncWriter::worker() {
+        while (true) {
+            Block blk;
+            {
+                std::unique_lock<std::mutex> lck(mtx);
+                queueCnd.wait(lck, [this]() { return !queue.empty() || stopWorker; });
+                if (queue.empty()) { break; }
+                blk = queue.front();
+                queue.pop_front();
+                writingLen = blk.len;
+            }
+
+#ifdef __linux__
+            // Reserve disk space ahead of the data so the filesystem doesn't have to allocate on every write
+            if (opts.preallocate && blk.offset + blk.len > preallocated) {
+                uint64_t step = std::max<uint64_t>(ASYNC_WRITER_PREALLOC_STEP, preallocated / 2);
+                if (!fallocate(fd, FALLOC_FL_KEEP_SIZE, preallocated, step)) {
+                    preallocated += step;
+                }
+                else {
+                    flog::warn("Could not preallocate disk space, disabling preallocation");
+                    opts.preallocate = false;
+                }
+            }
+#endif
+
+            // Direct IO can only write whole aligned blocks, which the last one usually isn't
+            if (direct && (blk.len % ASYNC_WRITER_ALIGNMENT || blk.offset % ASYNC_WRITER_ALIGNMENT)) {
+                disableDirectIO();
+            }
+
+            bool ok = writeFile(blk.offset, blk.data, blk.len);
+
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (!ok) { stats.error = true; }
+                double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - blk.filled).count();
+                stats.lastLatency = latency;
+                stats.maxLatency = std::max<double>(stats.maxLatency, latency);
+                freeBlocks.push_back(blk.data);
+                writingLen = 0;
+            }
+            drainCnd.notify_all();
+        }
+    }
+
+    // Only called from the worker, or with the worker idle and mtx held
+    bool AsyncWriter::writeFile(uint64_t offset, const uint8_t* data, size_t len) {
+#ifdef _WIN32
+        if (_lseeki64(fd, offset, SEEK_SET) < 0) { return false; }
+        while (len) {
+            int ret = _write(fd, data, (unsigned int)std::min<size_t>(len, 1 << 30));
+            if (ret <= 0) { return false; }
+            data += ret;
+            len -= ret;
+        }
+#else
+        while (len) {
+            ssize_t ret = pwrite(fd, data, len, offset);
+            if (ret < 0 && errno == EINTR) { continue; }
+            if (ret <= 0) { return false; }
+            data += ret;
+            offset += ret;
+            len -= ret;
+        }
+#endif
+        return true;
+    }
+
+    void AsyncWriter::disableDirectIO() {
+        if (!direct) { return; }
+#ifdef __linux__
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0) { fcntl(fd, F_SETFL, flags & ~O_DIRECT); }
+#endif
+        direct = false;
+    }
+}
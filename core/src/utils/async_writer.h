@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <stdint.h>
+
+namespace diskio {
+    struct Options {
+        size_t blockSize = 1024 * 1024;         // Size of each write, a multiple of 4096 bytes
+        size_t bufferSize = 64 * 1024 * 1024;   // Data that can wait in RAM before writes are dropped
+        bool directIO = false;                  // Bypass the page cache (O_DIRECT, Linux only)
+        bool preallocate = false;               // Reserve disk space ahead of the writes (Linux only)
+    };
+
+    struct Stats {
+        uint64_t overruns = 0;          // Writes dropped because the buffer was full
+        uint64_t droppedBytes = 0;
+        double lastLatency = 0.0;       // Time in ms from a block being filled to it being on disk
+        double maxLatency = 0.0;
+        size_t bufferedBytes = 0;
+        size_t bufferSize = 0;
+        bool error = false;             // A write to the file failed
+    };
+
+    /**
+     * Sequential file writer that never blocks the caller on the disk. Data is copied into a preallocated pool
+     * of aligned blocks, and full blocks are written by a dedicated thread. If the disk falls behind for longer
+     * than the pool can absorb, writes are dropped whole and counted instead of stalling the caller.
+     */
+    class AsyncWriter {
+    public:
+        AsyncWriter() {}
+        ~AsyncWriter();
+
+        bool open(std::string path, const Options& options = Options());
+        bool isOpen();
+
+        // Write everything buffered and close the file
+        void close();
+
+        // Returns false if the data was dropped, either all or none of it is written
+        bool write(const void* data, size_t len);
+
+        // Overwrite data that was already written, waits for the disk if it isn't in RAM anymore
+        bool writeAt(uint64_t pos, const void* data, size_t len);
+
+        // Position in the file of the next write
+        uint64_t tell();
+
+        Stats getStats();
+
+    private:
+        struct Block {
+            uint8_t* data;
+            size_t len;
+            uint64_t offset;
+            std::chrono::steady_clock::time_point filled;
+        };
+
+        void submitCurrent();
+        void worker();
+        bool writeFile(uint64_t offset, const uint8_t* data, size_t len);
+        void disableDirectIO();
+
+        std::mutex mtx;
+        std::condition_variable queueCnd;
+        std::condition_variable drainCnd;
+
+        int fd = -1;
+        Options opts;
+        bool direct = false;
+        uint64_t preallocated = 0;
+
+        std::vector<uint8_t*> allocations;
+        std::vector<uint8_t*> freeBlocks;
+        std::deque<Block> queue;
+        Block current = { NULL, 0, 0 };
+        size_t writingLen = 0;  // Size of the block the worker is writing, 0 if idle
+        bool stopWorker = false;
+        std::thread workerThread;
+
+        uint64_t position = 0;
+        Stats stats;
+    };
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <dsp/types.h>
+#include <volk/volk.h>
+#include <config.h>
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include "mapped_file.h"
+#include "wav_reader.h"
+
+// Bytes read ahead of the playback position
+#define IQ_FILE_READAHEAD   (32 * 1024 * 1024)
+
+enum SampleFormat {
+    SAMPLE_FORMAT_CU8,
+    SAMPLE_FORMAT_CS8,
+    SAMPLE_FORMAT_CS16,
+    SAMPLE_FORMAT_CF32
+};
+
+const size_t SAMPLE_FORMAT_SIZE[] = {
+    2*sizeof(uint8_t),
+    2*sizeof(int8_t),
+    2*sizeof(int16_t),
+    2*sizeof(float)
+};
+
+/**
+ * Memory mapped IQ recording. Supports WAV/RF64/Wave64 files, SigMF datasets and headerless files of
+ * interleaved samples, with the format taken from the extension (.cu8, .cs8, .cs16, .cf32) or given by the user.
+ * Reads wrap around at the end of the file.
+ */
+class IQFile {
+public:
+    IQFile() {}
+
+    // Throws if the file can't be opened or isn't in a supported format
+    void open(std::string path, SampleFormat rawFormat, double rawSampleRate) {
+        close();
+        std::filesystem::path p(path);
+        std::string ext = p.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+        std::string dataPath = path;
+        dataStart = 0;
+        _frequency = 0.0;
+        _hasFrequency = false;
+
+        if (ext == ".wav" || ext == ".w64") {
+            WavReader wav(path);
+            if (!wav.isValid()) { throw std::runtime_error("Invalid WAV file"); }
+            if (wav.getChannelCount() != 2) { throw std::runtime_error("WAV file isn't IQ (2 channels)"); }
+            if (wav.getSampleType() == WAV_SAMPLE_TYPE_FLOAT && wav.getBitDepth() == 32) { _format = SAMPLE_FORMAT_CF32; }
+            else if (wav.getBitDepth() == 16) { _format = SAMPLE_FORMAT_CS16; }
+            else if (wav.getBitDepth() == 8) { _format = SAMPLE_FORMAT_CU8; }
+            else { throw std::runtime_error("Unsupported WAV sample format"); }
+            _sampleRate = wav.getSampleRate();
+            dataStart = wav.getDataStart();
+            dataSize = wav.getDataSize();
+        }
+        else if (ext == ".sigmf-meta" || ext == ".sigmf-data") {
+            // Either file of the pair can be selected
+            std::string base = path.substr(0, path.size() - ext.size());
+            dataPath = base + ".sigmf-data";
+            parseSigMF(base + ".sigmf-meta");
+            dataSize = UINT64_MAX;
+        }
+        else {
+            if (ext == ".cu8") { _format = SAMPLE_FORMAT_CU8; }
+            else if (ext == ".cs8") { _format = SAMPLE_FORMAT_CS8; }
+            else if (ext == ".cs16") { _format = SAMPLE_FORMAT_CS16; }
+            else if (ext == ".cf32") { _format = SAMPLE_FORMAT_CF32; }
+            else { _format = rawFormat; }
+            _sampleRate = rawSampleRate;
+            dataSize = UINT64_MAX;
+        }
+        if (_sampleRate <= 0.0) { throw std::runtime_error("Sample rate may not be zero"); }
+
+        // Map the samples
+        if (!mf.open(dataPath)) { throw std::runtime_error("Could not map the file"); }
+        if (dataStart >= mf.size()) {
+            close();
+            throw std::runtime_error("File contains no samples");
+        }
+        dataSize = std::min<uint64_t>(dataSize, mf.size() - dataStart);
+        sampleSize = SAMPLE_FORMAT_SIZE[_format];
+        sampleCount = dataSize / sampleSize;
+        if (!sampleCount) {
+            close();
+            throw std::runtime_error("File contains no samples");
+        }
+        pos = 0;
+        prefetchBegin = 0;
+        prefetchEnd = 0;
+    }
+
+    void close() {
+        mf.close();
+        sampleCount = 0;
+        pos = 0;
+    }
+
+    bool isOpen() { return mf.isOpen(); }
+
+    SampleFormat getFormat() { return _format; }
+    double getSampleRate() { return _sampleRate; }
+    uint64_t getSampleCount() { return sampleCount; }
+
+    // Center frequency from the metadata, if the format has any
+    bool hasFrequency() { return _hasFrequency; }
+    double getFrequency() { return _frequency; }
+
+    uint64_t getPosition() { return pos; }
+
+    // Not thread safe with read()
+    void seek(uint64_t sample) {
+        pos = std::min<uint64_t>(sample, sampleCount - 1);
+    }
+
+    // Convert count samples from the current position, wrapping around at the end of the file
+    void read(dsp::complex_t* out, int count) {
+        uint64_t p = pos;
+        while (count) {
+            int n = std::min<uint64_t>(count, sampleCount - p);
+            convert(&mf.data()[dataStart + p * sampleSize], out, n, _format);
+            out += n;
+            count -= n;
+            p += n;
+            if (p >= sampleCount) { p = 0; }
+        }
+        pos = p;
+
+        // Keep the data ahead of the playback position on its way into memory
+        uint64_t off = p * sampleSize;
+        if (off < prefetchBegin || off + (IQ_FILE_READAHEAD / 2) > prefetchEnd) {
+            mf.prefetch(dataStart + off, IQ_FILE_READAHEAD);
+            prefetchBegin = off;
+            prefetchEnd = off + IQ_FILE_READAHEAD;
+        }
+    }
+
+    static void convert(const uint8_t* in, dsp::complex_t* out, int count, SampleFormat format) {
+        switch (format) {
+        case SAMPLE_FORMAT_CU8:
+            {
+                // Volk doesn't support unsigned ints, this loop vectorizes anyway
+                float* fout = (float*)out;
+                for (int i = 0; i < count * 2; i++) { fout[i] = ((float)in[i] - 127.5f) * (1.0f / 128.0f); }
+            }
+            break;
+        case SAMPLE_FORMAT_CS8:
+            volk_8i_s32f_convert_32f((float*)out, (const int8_t*)in, 128.0f, count * 2);
+            break;
+        case SAMPLE_FORMAT_CS16:
+            volk_16i_s32f_convert_32f((float*)out, (const int16_t*)in, 32768.0f, count * 2);
+            break;
+        case SAMPLE_FORMAT_CF32:
+            memcpy(out, in, count * sizeof(dsp::complex_t));
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    void parseSigMF(std::string metaPath) {
+        json meta;
+        try {
+            std::ifstream file(metaPath);
+            file >> meta;
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Could not read SigMF metadata: " + std::string(e.what()));
+        }
+        if (!meta.contains("global")) { throw std::runtime_error("SigMF metadata has no global object"); }
+        json global = meta["global"];
+
+        // Only little endian complex samples are supported
+        std::string type = global.contains("core:datatype") ? global["core:datatype"].get<std::string>() : "";
+        if (type == "cu8") { _format = SAMPLE_FORMAT_CU8; }
+        else if (type == "ci8") { _format = SAMPLE_FORMAT_CS8; }
+        else if (type == "ci16_le") { _format = SAMPLE_FORMAT_CS16; }
+        else if (type == "cf32_le") { _format = SAMPLE_FORMAT_CF32; }
+        else { throw std::runtime_error("Unsupported SigMF datatype: " + type); }
+
+        _sampleRate = global.contains("core:sample_rate") ? global["core:sample_rate"].get<double>() : 0.0;
+
+        // The first capture segment gives the frequency and the size of the header, if any
+        if (meta.contains("captures") && meta["captures"].is_array() && !meta["captures"].empty()) {
+            json capture = meta["captures"][0];
+            if (capture.contains("core:frequency")) {
+                _frequency = capture["core:frequency"].get<double>();
+                _hasFrequency = true;
+            }
+            if (capture.contains("core:header_bytes")) {
+                dataStart = capture["core:header_bytes"].get<uint64_t>();
+            }
+        }
+    }
+
+    MappedFile mf;
+    SampleFormat _format = SAMPLE_FORMAT_CS16;
+    double _sampleRate = 0.0;
+    double _frequency = 0.0;
+    bool _hasFrequency = false;
+
+    uint64_t dataStart = 0;
+    uint64_t dataSize = 0;
+    size_t sampleSize = 4;
+    uint64_t sampleCount = 0;
+    std::atomic<uint64_t> pos = 0;
+
+    uint64_t prefetchBegin = 0;
+    uint64_t prefetchEnd = 0;
+};
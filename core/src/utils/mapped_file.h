@@ -0,0 +1,110 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    bool open(std::string path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) { return false; }
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || !sz.QuadPart) {
+            close();
+            return false;
+        }
+        _size = sz.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            close();
+            return false;
+        }
+        _data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!_data) {
+            close();
+            return false;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { return false; }
+        struct stat st;
+        if (fstat(fd, &st) || !st.st_size) {
+            close();
+            return false;
+        }
+        _size = st.st_size;
+        void* ptr = mmap(NULL, _size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close();
+            return false;
+        }
+        _data = (const uint8_t*)ptr;
+
+        // Playback is mostly sequential, let the kernel read ahead aggressively
+        madvise(ptr, _size, MADV_SEQUENTIAL);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (_data) { UnmapViewOfFile(_data); }
+        if (mapping) { CloseHandle(mapping); }
+        if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (_data) { munmap((void*)_data, _size); }
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
+        _data = NULL;
+        _size = 0;
+    }
+
+    bool isOpen() { return _data != NULL; }
+    const uint8_t* data() { return _data; }
+    uint64_t size() { return _size; }
+
+    // Start reading a range in the background so that it's in memory when it's needed
+    void prefetch(uint64_t offset, uint64_t len) {
+        if (!_data || offset >= _size) { return; }
+        len = std::min<uint64_t>(len, _size - offset);
+#ifdef _WIN32
+        // The system's readahead for sequentially scanned files is used instead
+#else
+        // madvise needs a page aligned address
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        uint64_t begin = offset - (offset % page);
+        madvise((void*)&_data[begin], len + (offset - begin), MADV_WILLNEED);
+#endif
+    }
+
+private:
+    const uint8_t* _data = NULL;
+    uint64_t _size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
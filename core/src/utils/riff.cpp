@@ -4,8 +4,34 @@
 
 namespace riff {
     const char* RIFF_SIGNATURE      = "RIFF";
+    const char* RF64_SIGNATURE      = "RF64";
     const char* LIST_SIGNATURE      = "LIST";
+    const char* DS64_SIGNATURE      = "ds64";
+    const char* JUNK_SIGNATURE      = "JUNK";
+    const char* DATA_SIGNATURE      = "data";
     const size_t RIFF_LABEL_SIZE    = 4;
+    const uint32_t RF64_SIZE_MARKER = 0xFFFFFFFF;
+
+    // GUID suffixes used by Wave64 for the riff/list chunks and for everything else
+    const uint8_t W64_RIFF_SUFFIX[12]   = { 0x2E, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+    const uint8_t W64_LIST_SUFFIX[12]   = { 0x2F, 0x91, 0xCF, 0x11, 0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+    const uint8_t W64_CHUNK_SUFFIX[12]  = { 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+
+    void w64Guid(const char id[4], uint8_t guid[16]) {
+        if (!memcmp(id, RIFF_SIGNATURE, RIFF_LABEL_SIZE)) {
+            memcpy(guid, "riff", 4);
+            memcpy(&guid[4], W64_RIFF_SUFFIX, 12);
+        }
+        else if (!memcmp(id, LIST_SIGNATURE, RIFF_LABEL_SIZE)) {
+            memcpy(guid, "list", 4);
+            memcpy(&guid[4], W64_LIST_SUFFIX, 12);
+        }
+        else {
+            // Wave64 uses lower case codes for the standard chunks
+            for (int i = 0; i < 4; i++) { guid[i] = (id[i] >= 'A' && id[i] <= 'Z') ? (id[i] - 'A' + 'a') : id[i]; }
+            memcpy(&guid[4], W64_CHUNK_SUFFIX, 12);
+        }
+    }
 
     // Writer::Writer(const Writer&& b) {
     //     //file = std::move(b.file);
@@ -15,12 +41,16 @@ namespace riff {
         close();
     }
 
-    bool Writer::open(std::string path, const char form[4]) {
+    bool Writer::open(std::string path, const char form[4], const diskio::Options& options, Container container) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
 
         // Open file
-        file = std::ofstream(path, std::ios::out | std::ios::binary);
-        if (!file.is_open()) { return false; }
+        if (!file.open(path, options)) { return false; }
+
+        // Reset the large file state
+        _container = container;
+        needsRF64 = (container == CONTAINER_RF64);
+        ds64 = {};
 
         // Begin RIFF chunk
         beginRIFF(form);
@@ -30,7 +60,7 @@ namespace riff {
 
     bool Writer::isOpen() {
         std::lock_guard<std::recursive_mutex> lck(mtx);
-        return file.is_open();
+        return file.isOpen();
     }
 
     void Writer::close() {
@@ -50,7 +80,7 @@ namespace riff {
 
         // Create chunk with the LIST ID and write id
         beginChunk(LIST_SIGNATURE);
-        write((uint8_t*)id, RIFF_LABEL_SIZE);
+        writeLabel(id);
     }
 
     void Writer::endList() {
@@ -59,7 +89,7 @@ namespace riff {
         if (chunks.empty()) {
             throw std::runtime_error("No chunk to end");
         }
-        if (memcmp(chunks.top().hdr.id, LIST_SIGNATURE, RIFF_LABEL_SIZE)) {
+        if (memcmp(chunks.top().id, LIST_SIGNATURE, RIFF_LABEL_SIZE)) {
             throw std::runtime_error("Top chunk not LIST chunk");
         }
 
@@ -69,12 +99,25 @@ namespace riff {
     void Writer::beginChunk(const char id[4]) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
 
-        // Create and write header
+        // Create descriptor
         ChunkDesc desc;
-        desc.pos = file.tellp();
-        memcpy(desc.hdr.id, id, sizeof(desc.hdr.id));
-        desc.hdr.size = 0;
-        file.write((char*)&desc.hdr, sizeof(ChunkHeader));
+        desc.pos = file.tell();
+        memcpy(desc.id, id, sizeof(desc.id));
+        desc.size = 0;
+
+        // Write header, sizes are filled in when the chunk ends
+        if (_container == CONTAINER_W64) {
+            W64ChunkHeader hdr = {};
+            w64Guid(id, hdr.guid);
+            file.write(&hdr, sizeof(W64ChunkHeader));
+        }
+        else {
+            ChunkHeader hdr;
+            bool rf64 = (_container == CONTAINER_RF64 && !memcmp(id, RIFF_SIGNATURE, RIFF_LABEL_SIZE));
+            memcpy(hdr.id, rf64 ? RF64_SIGNATURE : id, sizeof(hdr.id));
+            hdr.size = 0;
+            file.write(&hdr, sizeof(ChunkHeader));
+        }
 
         // Save descriptor
         chunks.push(desc);
@@ -91,28 +134,63 @@ namespace riff {
         ChunkDesc desc = chunks.top();
         chunks.pop();
 
+        // Chunks are padded to an even size, or to a multiple of 8 bytes for Wave64
+        size_t pad = 0;
+        if (!chunks.empty()) {
+            pad = (_container == CONTAINER_W64) ? ((8 - (desc.size % 8)) % 8) : (desc.size & 1);
+        }
+        if (pad) {
+            uint8_t zeros[8] = {};
+            file.write(zeros, pad);
+        }
+
         // Write size
-        auto pos = file.tellp();
-        auto npos = desc.pos;
-        npos += 4;
-        file.seekp(npos);
-        file.write((char*)&desc.hdr.size, sizeof(desc.hdr.size));
-        file.seekp(pos);
-
-        // If parent chunk, increment its size by the size of the sub-chunk plus the size of its header)
+        size_t hdrSize;
+        if (_container == CONTAINER_W64) {
+            hdrSize = sizeof(W64ChunkHeader);
+            uint64_t size = desc.size + hdrSize;
+            file.writeAt(desc.pos + 16, &size, sizeof(size));
+        }
+        else {
+            // The RIFF and data chunks can go past 4GiB, their real size then goes in the ds64 chunk
+            hdrSize = sizeof(ChunkHeader);
+            bool isRIFF = !memcmp(desc.id, RIFF_SIGNATURE, RIFF_LABEL_SIZE);
+            bool isData = !memcmp(desc.id, DATA_SIGNATURE, RIFF_LABEL_SIZE);
+            if (isRIFF) { ds64.riffSize = desc.size; }
+            if (isData) { ds64.dataSize = desc.size; }
+            if (desc.size > RF64_SIZE_MARKER) {
+                if (!isRIFF && !isData) { throw std::runtime_error("Only the data chunk may be larger than 4GiB"); }
+                needsRF64 = true;
+            }
+            uint32_t size = (needsRF64 && (isRIFF || isData)) ? RF64_SIZE_MARKER : desc.size;
+            file.writeAt(desc.pos + 4, &size, sizeof(size));
+        }
+
+        // If parent chunk, increment its size by the size of the sub-chunk plus the size of its header and padding
         if (!chunks.empty()) {
-            chunks.top().hdr.size += desc.hdr.size + sizeof(ChunkHeader);
+            chunks.top().size += desc.size + hdrSize + pad;
         }
     }
 
-    void Writer::write(const uint8_t* data, size_t len) {
+    bool Writer::write(const uint8_t* data, size_t len) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
 
         if (chunks.empty()) {
             throw std::runtime_error("No chunk to write into");
         }
-        file.write((char*)data, len);
-        chunks.top().hdr.size += len;
+        if (!file.write(data, len)) { return false; }
+        chunks.top().size += len;
+        return true;
+    }
+
+    void Writer::setSampleCount(uint64_t count) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        ds64.sampleCount = count;
+    }
+
+    diskio::Stats Writer::getStats() {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        return file.getStats();
     }
 
     void Writer::beginRIFF(const char form[4]) {
@@ -124,7 +202,16 @@ namespace riff {
 
         // Create chunk with RIFF ID and write form
         beginChunk(RIFF_SIGNATURE);
-        write((uint8_t*)form, RIFF_LABEL_SIZE);
+        writeLabel(form);
+
+        // Reserve room for the ds64 chunk, a JUNK chunk holds its place until it's known whether it's needed
+        if (_container != CONTAINER_W64) {
+            DS64Chunk placeholder = {};
+            beginChunk((_container == CONTAINER_RF64) ? DS64_SIGNATURE : JUNK_SIGNATURE);
+            ds64Pos = file.tell();
+            write((uint8_t*)&placeholder, sizeof(DS64Chunk));
+            endChunk();
+        }
     }
 
     void Writer::endRIFF() {
@@ -133,10 +220,29 @@ namespace riff {
         if (chunks.empty()) {
             throw std::runtime_error("No chunk to end");
         }
-        if (memcmp(chunks.top().hdr.id, RIFF_SIGNATURE, RIFF_LABEL_SIZE)) {
+        if (memcmp(chunks.top().id, RIFF_SIGNATURE, RIFF_LABEL_SIZE)) {
             throw std::runtime_error("Top chunk not RIFF chunk");
         }
 
+        if (_container != CONTAINER_W64 && chunks.top().size > RF64_SIZE_MARKER) { needsRF64 = true; }
         endChunk();
+
+        // Turn the file into RF64 if anything was too large for plain RIFF
+        if (_container != CONTAINER_W64 && needsRF64) {
+            file.writeAt(0, RF64_SIGNATURE, RIFF_LABEL_SIZE);
+            file.writeAt(ds64Pos - sizeof(ChunkHeader), DS64_SIGNATURE, RIFF_LABEL_SIZE);
+            file.writeAt(ds64Pos, &ds64, sizeof(DS64Chunk));
+        }
+    }
+
+    void Writer::writeLabel(const char id[4]) {
+        if (_container == CONTAINER_W64) {
+            uint8_t guid[16];
+            w64Guid(id, guid);
+            write(guid, sizeof(guid));
+        }
+        else {
+            write((uint8_t*)id, RIFF_LABEL_SIZE);
+        }
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <mutex>
 #include <fstream>
+#include "async_writer.h"
 #include <string>
 #include <stack>
 #include <stdint.h>
@@ -11,11 +12,35 @@ namespace riff {
         char id[4];
         uint32_t size;
     };
+
+    // Sony Wave64 chunk header, the size includes the header itself
+    struct W64ChunkHeader {
+        uint8_t guid[16];
+        uint64_t size;
+    };
+
+    // EBU Tech 3306 RF64 size chunk, directly follows the form type
+    struct DS64Chunk {
+        uint64_t riffSize;
+        uint64_t dataSize;
+        uint64_t sampleCount;
+        uint32_t tableLength;
+    };
 #pragma pack(pop)
 
+    enum Container {
+        CONTAINER_RIFF,     // Plain RIFF, turned into RF64 on close if a size doesn't fit in 32 bits
+        CONTAINER_RF64,     // Always RF64
+        CONTAINER_W64       // Sony Wave64
+    };
+
+    // Wave64 GUID of a four character code
+    void w64Guid(const char id[4], uint8_t guid[16]);
+
     struct ChunkDesc {
-        ChunkHeader hdr;
-        std::streampos pos;
+        char id[4];
+        uint64_t size;
+        uint64_t pos;
     };
 
     class Writer {
@@ -24,7 +49,7 @@ namespace riff {
         // Writer(const Writer&& b);
         ~Writer();
 
-        bool open(std::string path, const char form[4]);
+        bool open(std::string path, const char form[4], const diskio::Options& options = diskio::Options(), Container container = CONTAINER_RIFF);
         bool isOpen();
         void close();
 
@@ -34,15 +59,29 @@ namespace riff {
         void beginChunk(const char id[4]);
         void endChunk();
 
-        void write(const uint8_t* data, size_t len);
+        // Returns false if the data was dropped because the disk couldn't keep up
+        bool write(const uint8_t* data, size_t len);
+
+        // Sample count stored in the ds64 chunk of RF64 files
+        void setSampleCount(uint64_t count);
+
+        diskio::Stats getStats();
 
     private:
         void beginRIFF(const char form[4]);
         void endRIFF();
 
+        // Write a four character code, or the matching GUID for Wave64
+        void writeLabel(const char id[4]);
+
         std::recursive_mutex mtx;
-        std::ofstream file;
+        diskio::AsyncWriter file;
         std::stack<ChunkDesc> chunks;
+
+        Container _container = CONTAINER_RIFF;
+        uint64_t ds64Pos = 0;
+        DS64Chunk ds64 = {};
+        bool needsRF64 = false;
     };
 
     // class Reader {
@@ -2,8 +2,8 @@
 #include <volk/volk.h>
 #include <stdexcept>
 #include <dsp/buffer/buffer.h>
-#include <dsp/stream.h>
 #include <map>
+#include <algorithm>
 
 namespace wav {
     const char* WAVE_FILE_TYPE          = "WAVE";
@@ -50,17 +50,11 @@ namespace wav {
         hdr.bytesPerSample = bytesPerSamp;
         hdr.bytesPerSecond = bytesPerSamp * _samplerate;
 
-        // Precompute sizes and allocate buffers
+        // Check the sample type, the conversion buffer is allocated by write() to fit the blocks it gets
         switch (_type) {
         case SAMP_TYPE_UINT8:
-            bufU8 = dsp::buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * _channels);
-            break;
         case SAMP_TYPE_INT16:
-            bufI16 = dsp::buffer::alloc<int16_t>(STREAM_BUFFER_SIZE * _channels);
-            break;
         case SAMP_TYPE_INT32:
-            bufI32 = dsp::buffer::alloc<int32_t>(STREAM_BUFFER_SIZE * _channels);
-            break;
         case SAMP_TYPE_FLOAT32:
             break;
         default:
@@ -68,8 +62,15 @@ namespace wav {
             break;
         }
 
-        // Open file
-        if (!rw.open(path, WAVE_FILE_TYPE)) { return false; }
+        // Open file with enough buffering for the requested time
+        diskio::Options opts;
+        opts.bufferSize = std::max<size_t>(_bufferSeconds * (double)hdr.bytesPerSecond, 4 * opts.blockSize);
+        opts.directIO = _directIO;
+        opts.preallocate = _preallocate;
+        riff::Container container = riff::CONTAINER_RIFF;
+        if (_format == FORMAT_RF64) { container = riff::CONTAINER_RF64; }
+        else if (_format == FORMAT_W64) { container = riff::CONTAINER_W64; }
+        if (!rw.open(path, WAVE_FILE_TYPE, opts, container)) { return false; }
 
         // Write format chunk
         rw.beginChunk(FORMAT_MARKER);
@@ -93,6 +94,7 @@ namespace wav {
         if (!rw.isOpen()) { return; }
 
         // Finish data chunk
+        rw.setSampleCount(samplesWritten);
         rw.endChunk();
 
         // Close the file
@@ -111,6 +113,7 @@ namespace wav {
             dsp::buffer::free(bufI32);
             bufI32 = NULL;
         }
+        bufSize = 0;
     }
 
     void Writer::setChannels(int channels) {
@@ -147,6 +150,15 @@ namespace wav {
         _type = type;
     }
 
+    void Writer::setBuffering(double seconds, bool directIO, bool preallocate) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _bufferSeconds = std::max<double>(seconds, 0.0);
+        _directIO = directIO;
+        _preallocate = preallocate;
+    }
+
     void Writer::write(float* samples, int count) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         if (!rw.isOpen()) { return; }
@@ -154,30 +166,34 @@ namespace wav {
         // Select different writer function depending on the chose depth
         int tcount = count * _channels;
         int tbytes = count * bytesPerSamp;
+        bool ok = false;
         switch (_type) {
         case SAMP_TYPE_UINT8:
             // Volk doesn't support unsigned ints yet :/
+            dsp::buffer::grow(bufU8, bufSize, tcount);
             for (int i = 0; i < tcount; i++) {
                 bufU8[i] = (samples[i] * 127.0f) + 128.0f;
             }
-            rw.write(bufU8, tbytes);
+            ok = rw.write(bufU8, tbytes);
             break;
         case SAMP_TYPE_INT16:
+            dsp::buffer::grow(bufI16, bufSize, tcount);
             volk_32f_s32f_convert_16i(bufI16, samples, 32767.0f, tcount);
-            rw.write((uint8_t*)bufI16, tbytes);
+            ok = rw.write((uint8_t*)bufI16, tbytes);
             break;
         case SAMP_TYPE_INT32:
+            dsp::buffer::grow(bufI32, bufSize, tcount);
             volk_32f_s32f_convert_32i(bufI32, samples, 2147483647.0f, tcount);
-            rw.write((uint8_t*)bufI32, tbytes);
+            ok = rw.write((uint8_t*)bufI32, tbytes);
             break;
         case SAMP_TYPE_FLOAT32:
-            rw.write((uint8_t*)samples, tbytes);
+            ok = rw.write((uint8_t*)samples, tbytes);
             break;
         default:
             break;
         }
 
-        // Increment sample counter
-        samplesWritten += count;
+        // Increment sample counter, samples dropped because the disk was too slow don't count
+        if (ok) { samplesWritten += count; }
     }
 }
@@ -18,8 +18,9 @@ namespace wav {
     #pragma pack(pop)
 
     enum Format {
-        FORMAT_WAV,
-        FORMAT_RF64
+        FORMAT_WAV,     // Switches to RF64 by itself if the file goes over 4GiB
+        FORMAT_RF64,
+        FORMAT_W64
     };
 
     enum SampleType {
@@ -48,7 +49,11 @@ namespace wav {
         void setFormat(Format format);
         void setSampleType(SampleType type);
 
-        size_t getSamplesWritten() { return samplesWritten; }
+        // Seconds of audio kept in RAM when the disk stalls, and disk options (see diskio::Options)
+        void setBuffering(double seconds, bool directIO = false, bool preallocate = false);
+
+        uint64_t getSamplesWritten() { return samplesWritten; }
+        diskio::Stats getStats() { return rw.getStats(); }
 
         void write(float* samples, int count);
 
@@ -62,10 +67,14 @@ namespace wav {
         Format _format;
         SampleType _type;
         size_t bytesPerSamp;
+        double _bufferSeconds = 5.0;
+        bool _directIO = false;
+        bool _preallocate = false;
 
         uint8_t* bufU8 = NULL;
         int16_t* bufI16 = NULL;
         int32_t* bufI32 = NULL;
-        size_t samplesWritten = 0;
+        int bufSize = 0;
+        uint64_t samplesWritten = 0;
     };
 }
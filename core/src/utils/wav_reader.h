@@ -0,0 +1,167 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include "riff.h"
+
+#define WAV_SIGNATURE       "RIFF"
+#define WAV_RF64_SIGNATURE  "RF64"
+#define WAV_TYPE            "WAVE"
+#define WAV_FORMAT_MARK     "fmt "
+#define WAV_DS64_MARK       "ds64"
+#define WAV_DATA_MARK       "data"
+#define WAV_SAMPLE_TYPE_PCM 1
+#define WAV_SAMPLE_TYPE_FLOAT 3
+
+// Parses the headers of WAV, RF64 and Sony Wave64 files to find the format and location of the samples
+class WavReader {
+public:
+    WavReader(std::string path) {
+        file = std::ifstream(path.c_str(), std::ios::binary);
+        valid = parse();
+        file.close();
+    }
+
+    uint16_t getSampleType() {
+        return fmt.sampleType;
+    }
+
+    uint16_t getBitDepth() {
+        return fmt.bitDepth;
+    }
+
+    uint16_t getChannelCount() {
+        return fmt.channelCount;
+    }
+
+    uint32_t getSampleRate() {
+        return fmt.sampleRate;
+    }
+
+    // Offset of the samples in the file
+    uint64_t getDataStart() {
+        return dataStart;
+    }
+
+    uint64_t getDataSize() {
+        return dataSize;
+    }
+
+    bool isValid() {
+        return valid;
+    }
+
+private:
+#pragma pack(push, 1)
+    struct FormatHeader_t {
+        uint16_t sampleType; // PCM (1)
+        uint16_t channelCount;
+        uint32_t sampleRate;
+        uint32_t bytesPerSecond;
+        uint16_t bytesPerSample;
+        uint16_t bitDepth;
+    };
+#pragma pack(pop)
+
+    bool parse() {
+        if (!file.is_open()) { return false; }
+        file.seekg(0, std::ios::end);
+        uint64_t fileSize = file.tellg();
+        file.seekg(0);
+
+        // Identify the container
+        char sig[4];
+        if (!file.read(sig, 4)) { return false; }
+        bool rf64 = !memcmp(sig, WAV_RF64_SIGNATURE, 4);
+        bool w64 = false;
+        uint64_t pos;
+        if (rf64 || !memcmp(sig, WAV_SIGNATURE, 4)) {
+            riff::ChunkHeader hdr;
+            char form[4];
+            file.seekg(0);
+            if (!file.read((char*)&hdr, sizeof(hdr)) || !file.read(form, 4)) { return false; }
+            if (memcmp(form, WAV_TYPE, 4)) { return false; }
+            pos = sizeof(hdr) + 4;
+        }
+        else {
+            riff::W64ChunkHeader hdr;
+            uint8_t form[16];
+            file.seekg(0);
+            if (!file.read((char*)&hdr, sizeof(hdr)) || !file.read((char*)form, 16)) { return false; }
+            if (!guidIs(hdr.guid, WAV_SIGNATURE) || !guidIs(form, WAV_TYPE)) { return false; }
+            w64 = true;
+            pos = sizeof(hdr) + 16;
+        }
+
+        // Go through the chunks until the format and data are found
+        bool fmtFound = false;
+        bool dataFound = false;
+        uint64_t ds64DataSize = 0;
+        while (!(fmtFound && dataFound) && pos < fileSize) {
+            file.clear();
+            file.seekg(pos);
+
+            // Read the chunk header, a size of zero on the data chunk means the file wasn't closed properly
+            uint64_t size;
+            uint64_t hdrSize;
+            bool isFmt, isData, isDS64;
+            if (w64) {
+                riff::W64ChunkHeader hdr;
+                if (!file.read((char*)&hdr, sizeof(hdr))) { break; }
+                hdrSize = sizeof(hdr);
+                size = (hdr.size > hdrSize) ? (hdr.size - hdrSize) : 0;
+                isFmt = guidIs(hdr.guid, WAV_FORMAT_MARK);
+                isData = guidIs(hdr.guid, WAV_DATA_MARK);
+                isDS64 = false;
+            }
+            else {
+                riff::ChunkHeader hdr;
+                if (!file.read((char*)&hdr, sizeof(hdr))) { break; }
+                hdrSize = sizeof(hdr);
+                size = hdr.size;
+                isFmt = !memcmp(hdr.id, WAV_FORMAT_MARK, 4);
+                isData = !memcmp(hdr.id, WAV_DATA_MARK, 4);
+                isDS64 = !memcmp(hdr.id, WAV_DS64_MARK, 4);
+                if (rf64 && isData && hdr.size == 0xFFFFFFFF) { size = ds64DataSize; }
+            }
+
+            if (isFmt) {
+                // Only the common part is needed, extensible headers are longer
+                if (size < sizeof(FormatHeader_t) || !file.read((char*)&fmt, sizeof(FormatHeader_t))) { return false; }
+                fmtFound = true;
+            }
+            else if (isDS64) {
+                riff::DS64Chunk ds64;
+                if (size < sizeof(ds64) || !file.read((char*)&ds64, sizeof(ds64))) { return false; }
+                ds64DataSize = ds64.dataSize;
+            }
+            else if (isData) {
+                dataStart = pos + hdrSize;
+                uint64_t avail = fileSize - dataStart;
+                dataSize = (size && size <= avail) ? size : avail;
+                dataFound = true;
+            }
+
+            // Skip to the next chunk, RIFF pads to 2 bytes and Wave64 to 8
+            pos += hdrSize + size;
+            pos += w64 ? ((8 - (pos % 8)) % 8) : (pos & 1);
+        }
+
+        // Only keep whole frames so that looping doesn't shift the channels
+        if (fmt.bytesPerSample) { dataSize -= dataSize % fmt.bytesPerSample; }
+
+        return fmtFound && dataFound;
+    }
+
+    bool guidIs(const uint8_t guid[16], const char id[4]) {
+        uint8_t ref[16];
+        riff::w64Guid(id, ref);
+        return !memcmp(guid, ref, 16);
+    }
+
+    bool valid = false;
+    std::ifstream file;
+    FormatHeader_t fmt = {};
+    uint64_t dataStart = 0;
+    uint64_t dataSize = 0;
+};
@@ -77,6 +77,7 @@ public:
         ifChain.addBlock(&nb, false);
         ifChain.addBlock(&squelch, false);
         ifChain.addBlock(&fmnr, false);
+        ifChain.setFused(true, [](dsp::stream<dsp::complex_t>* out){});
 
         // Initialize audio DSP chain
         afChain.init(&dummyAudioStream);
@@ -86,6 +87,7 @@ public:
 
         afChain.addBlock(&resamp, true);
         afChain.addBlock(&deemp, false);
+        afChain.setFused(true, [](dsp::stream<dsp::stereo_t>* out){});
 
         // Initialize the sink
         srChangeHandler.ctx = this;
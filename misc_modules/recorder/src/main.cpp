@@ -7,7 +7,10 @@
 #include <dsp/routing/splitter.h>
 #include <dsp/audio/volume.h>
 #include <dsp/convert/stereo_to_mono.h>
+#include <dsp/buffer/history_buffer.h>
 #include <thread>
+#include <condition_variable>
+#include <atomic>
 #include <ctime>
 #include <gui/gui.h>
 #include <filesystem>
@@ -27,6 +30,9 @@
 
 #define SILENCE_LVL 10e-6
 
+// Frames copied out of the time shift history at once
+#define DUMP_BLOCK_SIZE 65536
+
 SDRPP_MOD_INFO{
     /* Name:            */ "recorder",
     /* Description:     */ "Recorder module for SDR++",
@@ -46,7 +52,8 @@ public:
 
         // Define option lists
         containers.define("WAV", wav::FORMAT_WAV);
-        // containers.define("RF64", wav::FORMAT_RF64); // Disabled for now
+        containers.define("RF64", wav::FORMAT_RF64);
+        containers.define("W64", wav::FORMAT_W64);
         sampleTypes.define(wav::SAMP_TYPE_UINT8, "Uint8", wav::SAMP_TYPE_UINT8);
         sampleTypes.define(wav::SAMP_TYPE_INT16, "Int16", wav::SAMP_TYPE_INT16);
         sampleTypes.define(wav::SAMP_TYPE_INT32, "Int32", wav::SAMP_TYPE_INT32);
@@ -82,6 +89,30 @@ public:
         if (config.conf[name].contains("ignoreSilence")) {
             ignoreSilence = config.conf[name]["ignoreSilence"];
         }
+        if (config.conf[name].contains("bufferSeconds")) {
+            bufferSeconds = config.conf[name]["bufferSeconds"];
+        }
+        if (config.conf[name].contains("directIO")) {
+            directIO = config.conf[name]["directIO"];
+        }
+        if (config.conf[name].contains("preallocate")) {
+            preallocate = config.conf[name]["preallocate"];
+        }
+        if (config.conf[name].contains("timeShift")) {
+            timeShift = config.conf[name]["timeShift"];
+        }
+        if (config.conf[name].contains("preTrigger")) {
+            preTrigger = config.conf[name]["preTrigger"];
+        }
+        if (config.conf[name].contains("postTrigger")) {
+            postTrigger = config.conf[name]["postTrigger"];
+        }
+        if (config.conf[name].contains("compactHistory")) {
+            compactHistory = config.conf[name]["compactHistory"];
+        }
+        if (config.conf[name].contains("squelchTrigger")) {
+            squelchTrigger = config.conf[name]["squelchTrigger"];
+        }
         if (config.conf[name].contains("nameTemplate")) {
             std::string _nameTemplate = config.conf[name]["nameTemplate"];
             if (_nameTemplate.length() > sizeof(nameTemplate)-1) {
@@ -102,6 +133,7 @@ public:
         basebandSink.init(NULL, complexHandler, this);
         stereoSink.init(&stereoStream, stereoHandler, this);
         monoSink.init(&s2m.out, monoHandler, this);
+        squelchSink.init(&squelchStream, squelchHandler, this);
 
         gui::menu.registerEntry(name, menuHandler, this);
         core::modComManager.registerInterface("recorder", name, moduleInterfaceHandler, this);
@@ -166,13 +198,26 @@ public:
         writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
         writer.setSampleType(sampleTypes[sampleTypeId]);
         writer.setSamplerate(samplerate);
+        writer.setBuffering(bufferSeconds, directIO, preallocate);
+
+        // In time shift mode, only fill the history until a trigger starts a dump
+        if (timeShift) {
+            int channels = (recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2;
+            std::lock_guard<std::mutex> lck(dumpMtx);
+            try {
+                history = new dsp::buffer::HistoryBuffer(channels, (uint64_t)(preTrigger + 1) * samplerate, compactHistory);
+            }
+            catch (const std::exception& e) {
+                flog::error("Failed to create the time shift history: {0}", e.what());
+                return;
+            }
+            triggerCount = 0;
+            armed = true;
 
-        // Open file
-        std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
-        std::string extension = ".wav";
-        std::string expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, recMode, vfoName) + extension);
-        if (!writer.open(expandedPath)) {
-            flog::error("Failed to open file for recording: {0}", expandedPath);
+            // The dump thread lives as long as the recorder is armed and waits for triggers
+            dumpThread = std::thread(&RecorderModule::dumpWorker, this);
+        }
+        else if (!openFile()) {
             return;
         }
 
@@ -196,6 +241,13 @@ public:
             sigpath::iqFrontEnd.bindIQStream(basebandStream);
         }
 
+        // Watch the selected audio stream for the squelch opening
+        if (timeShift && squelchTrigger) {
+            squelchOpen = true;
+            squelchSink.start();
+            splitter.bindStream(&squelchStream);
+        }
+
         recording = true;
     }
 
@@ -203,6 +255,11 @@ public:
         std::lock_guard<std::recursive_mutex> lck(recMtx);
         if (!recording) { return; }
 
+        if (armed && squelchTrigger) {
+            splitter.unbindStream(&squelchStream);
+            squelchSink.stop();
+        }
+
         // Close audio stream or baseband
         if (recMode == RECORDER_MODE_AUDIO) {
             splitter.unbindStream(&stereoStream);
@@ -212,18 +269,54 @@ public:
             
         }
         else {
-            // Unbind and destroy IQ stream
-            sigpath::iqFrontEnd.unbindIQStream(basebandStream);
+            // Stop the sink before unbinding so that it's done with the shared baseband buffer, then destroy the IQ stream
             basebandSink.stop();
+            sigpath::iqFrontEnd.unbindIQStream(basebandStream);
             delete basebandStream;
         }
 
+        // Let a dump in progress write what was captured so far, then free the history
+        if (armed) {
+            {
+                std::lock_guard<std::mutex> lck(dumpMtx);
+                stopDump = true;
+            }
+            dumpCnd.notify_all();
+            if (dumpThread.joinable()) { dumpThread.join(); }
+            std::lock_guard<std::mutex> lck(dumpMtx);
+            delete history;
+            history = NULL;
+            stopDump = false;
+            armed = false;
+        }
+
         // Close file
         writer.close();
         
         recording = false;
     }
 
+    // Start a dump of the time shift history, or extend the one in progress. Never waits on the dump thread
+    // since it's also called from the DSP thread when the squelch opens.
+    void trigger() {
+        std::lock_guard<std::mutex> lck(dumpMtx);
+        if (!history || stopDump) { return; }
+        uint64_t now = history->getWritten();
+        uint64_t end = now + (uint64_t)postTrigger * samplerate;
+        triggerCount++;
+        if (dumping) {
+            dumpEnd = std::max<uint64_t>(dumpEnd, end);
+            return;
+        }
+
+        // If the previous dump is still closing its file, the dump thread starts this one right after
+        uint64_t pre = (uint64_t)preTrigger * samplerate;
+        dumpStart = (now > pre) ? (now - pre) : 0;
+        dumpEnd = end;
+        dumping = true;
+        dumpCnd.notify_all();
+    }
+
 private:
     static void menuHandler(void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
@@ -282,10 +375,77 @@ private:
             config.release(true);
         }
 
+        ImGui::LeftLabel("Buffer");
+        ImGui::FillWidth();
+        if (ImGui::SliderInt(CONCAT("##_recorder_buffer_", _this->name), &_this->bufferSeconds, 1, 60, "%d s")) {
+            config.acquire();
+            config.conf[_this->name]["bufferSeconds"] = _this->bufferSeconds;
+            config.release(true);
+        }
+
+#ifdef __linux__
+        if (ImGui::Checkbox(CONCAT("Direct IO##_recorder_direct_io_", _this->name), &_this->directIO)) {
+            config.acquire();
+            config.conf[_this->name]["directIO"] = _this->directIO;
+            config.release(true);
+        }
+
+        if (ImGui::Checkbox(CONCAT("Preallocate##_recorder_preallocate_", _this->name), &_this->preallocate)) {
+            config.acquire();
+            config.conf[_this->name]["preallocate"] = _this->preallocate;
+            config.release(true);
+        }
+#endif
+
+        // Time shift, keeps the last seconds in RAM and only writes them to disk when triggered
+        if (ImGui::Checkbox(CONCAT("Time shift##_recorder_time_shift_", _this->name), &_this->timeShift)) {
+            config.acquire();
+            config.conf[_this->name]["timeShift"] = _this->timeShift;
+            config.release(true);
+        }
+        if (_this->timeShift) {
+            ImGui::LeftLabel("Pre-trigger");
+            ImGui::FillWidth();
+            if (ImGui::SliderInt(CONCAT("##_recorder_pre_trigger_", _this->name), &_this->preTrigger, 1, 60, "%d s")) {
+                config.acquire();
+                config.conf[_this->name]["preTrigger"] = _this->preTrigger;
+                config.release(true);
+            }
+
+            ImGui::LeftLabel("Post-trigger");
+            ImGui::FillWidth();
+            if (ImGui::SliderInt(CONCAT("##_recorder_post_trigger_", _this->name), &_this->postTrigger, 1, 300, "%d s")) {
+                config.acquire();
+                config.conf[_this->name]["postTrigger"] = _this->postTrigger;
+                config.release(true);
+            }
+
+            if (ImGui::Checkbox(CONCAT("Store as Int16##_recorder_compact_history_", _this->name), &_this->compactHistory)) {
+                config.acquire();
+                config.conf[_this->name]["compactHistory"] = _this->compactHistory;
+                config.release(true);
+            }
+
+            if (ImGui::Checkbox(CONCAT("Trigger on squelch##_recorder_squelch_trigger_", _this->name), &_this->squelchTrigger)) {
+                config.acquire();
+                config.conf[_this->name]["squelchTrigger"] = _this->squelchTrigger;
+                config.release(true);
+            }
+
+            // Memory needed for the history at the current samplerate
+            double rate = sigpath::iqFrontEnd.getSampleRate();
+            if (_this->recMode == RECORDER_MODE_AUDIO) {
+                rate = _this->selectedStreamName.empty() ? 0.0 : sigpath::sinkManager.getStreamSampleRate(_this->selectedStreamName);
+            }
+            int channels = (_this->recMode == RECORDER_MODE_AUDIO && !_this->stereo) ? 1 : 2;
+            double bytes = (double)(_this->preTrigger + 1) * rate * channels * (_this->compactHistory ? sizeof(int16_t) : sizeof(float));
+            ImGui::Text("History: %.0fMB", bytes / 1e6);
+        }
+
         if (_this->recording) { style::endDisabled(); }
 
-        // Show additional audio options
-        if (_this->recMode == RECORDER_MODE_AUDIO) {
+        // The audio stream is also needed in baseband mode to watch the squelch
+        if (_this->recMode == RECORDER_MODE_AUDIO || (_this->timeShift && _this->squelchTrigger)) {
             if (_this->recording) { style::beginDisabled(); }
             ImGui::LeftLabel("Stream");
             ImGui::FillWidth();
@@ -296,7 +456,10 @@ private:
                 config.release(true);
             }
             if (_this->recording) { style::endDisabled(); }
+        }
 
+        // Show additional audio options
+        if (_this->recMode == RECORDER_MODE_AUDIO) {
             _this->updateAudioMeter(_this->audioLvl);
             ImGui::FillWidth();
             ImGui::VolumeMeter(_this->audioLvl.l, _this->audioLvl.l, -60, 10);
@@ -330,24 +493,65 @@ private:
         bool canRecord = _this->folderSelect.pathIsValid();
         if (_this->recMode == RECORDER_MODE_AUDIO) { canRecord &= !_this->selectedStreamName.empty(); }
         if (!_this->recording) {
-            if (ImGui::Button(CONCAT("Record##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
+            if (ImGui::Button(CONCAT(_this->timeShift ? "Arm##_recorder_rec_" : "Record##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
                 _this->start();
             }
             ImGui::TextColored(ImGui::GetStyleColorVec4(ImGuiCol_Text), "Idle --:--:--");
         }
         else {
-            if (ImGui::Button(CONCAT("Stop##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
+            if (_this->armed) {
+                ImGui::BeginTable(CONCAT("recorder_arm_btn_table_", _this->name), 2);
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                if (ImGui::Button(CONCAT("Disarm##_recorder_rec_", _this->name), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
+                    _this->stop();
+                }
+                ImGui::TableSetColumnIndex(1);
+                if (ImGui::Button(CONCAT("Trigger##_recorder_trigger_", _this->name), ImVec2(ImGui::GetContentRegionAvail().x, 0))) {
+                    _this->trigger();
+                }
+                ImGui::EndTable();
+            }
+            else if (ImGui::Button(CONCAT("Stop##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
                 _this->stop();
             }
-            uint64_t seconds = _this->writer.getSamplesWritten() / _this->samplerate;
-            time_t diff = seconds;
-            tm* dtm = gmtime(&diff);
 
-            if (_this->ignoreSilence && _this->ignoringSilence) {
-                ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Paused %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
+            if (_this->armed && !_this->dumping) {
+                // Amount of history available for the next dump
+                uint64_t buffered = 0;
+                {
+                    std::lock_guard<std::mutex> lck(_this->dumpMtx);
+                    if (_this->history) { buffered = std::min<uint64_t>(_this->history->getWritten(), (uint64_t)_this->preTrigger * _this->samplerate); }
+                }
+                ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Armed, %llus buffered", (unsigned long long)(buffered / _this->samplerate));
+                ImGui::Text("Triggers: %d", _this->triggerCount);
             }
             else {
-                ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
+                uint64_t seconds = _this->writer.getSamplesWritten() / _this->samplerate;
+                time_t diff = seconds;
+                tm* dtm = gmtime(&diff);
+
+                if (_this->ignoreSilence && _this->ignoringSilence) {
+                    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Paused %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
+                }
+                else {
+                    ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
+                }
+
+                // Disk statistics
+                diskio::Stats stats = _this->writer.getStats();
+                float usage = stats.bufferSize ? (float)stats.bufferedBytes / (float)stats.bufferSize : 0.0f;
+                ImGui::Text("Buffer: %.0f%%", usage * 100.0f);
+                ImGui::Text("Write latency: %.0fms (max %.0fms)", stats.lastLatency, stats.maxLatency);
+                if (stats.overruns) {
+                    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Overruns: %llu (%.1fMB lost)", (unsigned long long)stats.overruns, (double)stats.droppedBytes / 1e6);
+                }
+                else {
+                    ImGui::Text("Overruns: 0");
+                }
+                if (stats.error) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Disk write error");
+                }
             }
         }
     }
@@ -499,6 +703,68 @@ private:
         return templ;
     }
 
+    std::string getExtension() {
+        return (containers[containerId] == wav::FORMAT_W64) ? ".w64" : ".wav";
+    }
+
+    bool openFile() {
+        std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
+        std::string expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, recMode, vfoName) + getExtension());
+        if (!writer.open(expandedPath)) {
+            flog::error("Failed to open file for recording: {0}", expandedPath);
+            return false;
+        }
+        return true;
+    }
+
+    void dumpWorker() {
+        float* buf = dsp::buffer::alloc<float>(DUMP_BLOCK_SIZE * history->getChannels());
+        while (true) {
+            // Wait for a trigger, a dump requested before stopping is still written out
+            {
+                std::unique_lock<std::mutex> lck(dumpMtx);
+                dumpCnd.wait(lck, [=]() { return dumping || stopDump; });
+                if (!dumping) { break; }
+            }
+            dump(buf);
+        }
+        dsp::buffer::free(buf);
+    }
+
+    void dump(float* buf) {
+        bool opened = openFile();
+        uint64_t pos;
+        {
+            std::lock_guard<std::mutex> lck(dumpMtx);
+            pos = dumpStart;
+        }
+        uint64_t lost = 0;
+
+        // Copy the history up to the end of the dump, waiting for new samples once caught up
+        while (true) {
+            uint64_t from = pos;
+            int count = history->read(from, buf, std::min<uint64_t>(DUMP_BLOCK_SIZE, (dumpEnd > pos) ? (dumpEnd - pos) : 0));
+            lost += from - pos;
+            pos = from;
+            if (count) {
+                if (opened) { writer.write(buf, count); }
+                pos += count;
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lck(dumpMtx);
+                if (pos >= dumpEnd || stopDump) {
+                    dumping = false;
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        if (lost) { flog::warn("Recorder '{0}': {1} samples were overwritten before they could be dumped", name, lost); }
+        writer.close();
+    }
+
     std::string expandString(std::string input) {
         input = std::regex_replace(input, std::regex("%ROOT%"), root);
         return std::regex_replace(input, std::regex("//"), "/");
@@ -506,11 +772,19 @@ private:
 
     static void complexHandler(dsp::complex_t* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
+        if (_this->armed) {
+            _this->history->write((float*)data, count);
+            return;
+        }
         _this->writer.write((float*)data, count);
     }
 
     static void stereoHandler(dsp::stereo_t* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
+        if (_this->armed) {
+            _this->history->write((float*)data, count);
+            return;
+        }
         if (_this->ignoreSilence) {
             float absMax = 0.0f;
             float* _data = (float*)data;
@@ -527,6 +801,10 @@ private:
 
     static void monoHandler(float* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
+        if (_this->armed) {
+            _this->history->write(data, count);
+            return;
+        }
         if (_this->ignoreSilence) {
             float absMax = 0.0f;
             for (int i = 0; i < count; i++) {
@@ -539,6 +817,22 @@ private:
         _this->writer.write(data, count);
     }
 
+    static void squelchHandler(dsp::stereo_t* data, int count, void* ctx) {
+        RecorderModule* _this = (RecorderModule*)ctx;
+        float absMax = 0.0f;
+        float* _data = (float*)data;
+        int _count = count * 2;
+        for (int i = 0; i < _count; i++) {
+            float val = fabsf(_data[i]);
+            if (val > absMax) { absMax = val; }
+        }
+
+        // Trigger when the audio comes back after silence
+        bool open = (absMax >= SILENCE_LVL);
+        if (open && !_this->squelchOpen) { _this->trigger(); }
+        _this->squelchOpen = open;
+    }
+
     static void moduleInterfaceHandler(int code, void* in, void* out, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
         std::lock_guard lck(_this->recMtx);
@@ -557,6 +851,9 @@ private:
         else if (code == RECORDER_IFACE_CMD_STOP) {
             if (_this->recording) { _this->stop(); }
         }
+        else if (code == RECORDER_IFACE_CMD_TRIGGER) {
+            _this->trigger();
+        }
     }
 
     std::string name;
@@ -575,6 +872,14 @@ private:
     std::string selectedStreamName = "";
     float audioVolume = 1.0f;
     bool ignoreSilence = false;
+    int bufferSeconds = 5;
+    bool directIO = false;
+    bool preallocate = true;
+    bool timeShift = false;
+    int preTrigger = 10;
+    int postTrigger = 10;
+    bool compactHistory = true;
+    bool squelchTrigger = false;
     dsp::stereo_t audioLvl = { -100.0f, -100.0f };
 
     bool recording = false;
@@ -587,6 +892,21 @@ private:
     dsp::sink::Handler<dsp::stereo_t> stereoSink;
     dsp::sink::Handler<float> monoSink;
 
+    // Time shift
+    bool armed = false;
+    dsp::buffer::HistoryBuffer* history = NULL;
+    std::mutex dumpMtx;
+    std::condition_variable dumpCnd;
+    std::thread dumpThread;
+    bool dumping = false;
+    bool stopDump = false;
+    uint64_t dumpStart = 0;
+    std::atomic<uint64_t> dumpEnd = 0;
+    int triggerCount = 0;
+    bool squelchOpen = true;
+    dsp::stream<dsp::stereo_t> squelchStream;
+    dsp::sink::Handler<dsp::stereo_t> squelchSink;
+
     OptionList<std::string, std::string> audioStreams;
     int streamId = 0;
     dsp::stream<dsp::stereo_t>* audioStream = NULL;
@@ -578,6 +578,18 @@ private:
             resp = "RPRT 0\n";
             client->write(resp.size(), (uint8_t*)resp.c_str());
         }
+        else if (parts[0] == "\\recorder_trigger") {
+            std::lock_guard lck(recorderMtx);
+
+            // Only the recorder keeps a time shift history to dump
+            if (recordingEnabled && recorderType == RECORDER_TYPE_RECORDER) {
+                core::modComManager.callInterface(selectedRecorder, RECORDER_IFACE_CMD_TRIGGER, NULL, NULL);
+            }
+
+            // Respond with a success
+            resp = "RPRT 0\n";
+            client->write(resp.size(), (uint8_t*)resp.c_str());
+        }
         else if (parts[0] == "q" || parts[0] == "\\quit") {
             // Will close automatically
         }
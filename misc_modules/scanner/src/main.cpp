@@ -3,6 +3,8 @@
 #include <gui/gui.h>
 #include <gui/style.h>
 #include <signal_path/signal_path.h>
+#include <core.h>
+#include <recorder_interface.h>
 #include <chrono>
 
 SDRPP_MOD_INFO{
@@ -81,6 +83,9 @@ private:
         ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
         ImGui::SliderFloat("##scanner_level", &_this->level, -150.0, 0.0);
 
+        // Dump the time shift history of the recorders when a signal is found
+        ImGui::Checkbox("Trigger recorders##scanner_trigger_rec", &_this->triggerRecorders);
+
         ImGui::BeginTable(("scanner_bottom_btn_table" + _this->name).c_str(), 2);
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
@@ -249,12 +254,20 @@ private:
                 found = true;
                 receiving = true;
                 current = freq;
+                if (triggerRecorders) { triggerAllRecorders(); }
                 break;
             }
         }
         return found;
     }
 
+    void triggerAllRecorders() {
+        for (auto const& [_name, inst] : core::moduleManager.instances) {
+            if (core::moduleManager.getInstanceModuleName(_name) != "recorder") { continue; }
+            core::modComManager.callInterface(_name, RECORDER_IFACE_CMD_TRIGGER, NULL, NULL);
+        }
+    }
+
     float getMaxLevel(float* data, double freq, double width, int dataWidth, double wfStart, double wfWidth) {
         double low = freq - (width/2.0);
         double high = freq + (width/2.0);
@@ -284,6 +297,7 @@ private:
     bool tuning = false;
     bool scanUp = true;
     bool reverseLock = false;
+    bool triggerRecorders = false;
     std::chrono::time_point<std::chrono::high_resolution_clock> lastSignalTime;
     std::chrono::time_point<std::chrono::high_resolution_clock> lastTuneTime;
     std::thread workerThread;
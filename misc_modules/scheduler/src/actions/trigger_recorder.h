@@ -0,0 +1,92 @@
+#pragma once
+#include <sched_action.h>
+#include <core.h>
+#include <gui/style.h>
+#include <recorder_interface.h>
+
+namespace sched_action {
+    class TriggerRecorderClass : public ActionClass {
+    public:
+        TriggerRecorderClass() {}
+        ~TriggerRecorderClass() {}
+
+        void trigger() {
+            if (recorderName.empty()) { return; }
+            core::modComManager.callInterface(recorderName, RECORDER_IFACE_CMD_TRIGGER, NULL, NULL);
+        }
+
+        void prepareEditMenu() {
+            // Generate text list of the recorders
+            recorderNameId = -1;
+            recorderNames.clear();
+            recorderNamesTxt.clear();
+            int id = 0;
+            for (auto& [name, inst] : core::moduleManager.instances) {
+                if (core::moduleManager.getInstanceModuleName(name) != "recorder") { continue; }
+                recorderNames.push_back(name);
+                recorderNamesTxt += name;
+                recorderNamesTxt += '\0';
+                if (name == recorderName) {
+                    recorderNameId = id;
+                }
+                id++;
+            }
+
+            // If recorder not found, select the first one
+            if (recorderNameId < 0 && !recorderNames.empty()) {
+                recorderNameId = 0;
+            }
+        }
+
+        bool showEditMenu(bool& valid) {
+            ImGui::LeftLabel("Recorder");
+            ImGui::SetNextItemWidth(250 - ImGui::GetCursorPosX());
+            ImGui::Combo("##scheduler_action_triggerrec_edit_rec", &recorderNameId, recorderNamesTxt.c_str());
+
+            if (recorderNameId < 0) { style::beginDisabled(); }
+            if (ImGui::Button("Apply")) {
+                recorderName = recorderNames[recorderNameId];
+                name = "Trigger \"" + recorderName + "\"";
+                valid = true;
+                return false;
+            }
+            if (recorderNameId < 0) { style::endDisabled(); }
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel")) {
+                valid = false;
+                return false;
+            }
+
+            return true;
+        }
+
+        void loadFromConfig(json config) {
+            if (config.contains("recorder")) { recorderName = config["recorder"]; }
+            name = "Trigger \"" + recorderName + "\"";
+        }
+
+        json saveToConfig() {
+            json config;
+            config["recorder"] = recorderName;
+            return config;
+        }
+
+
+        std::string getName() {
+            return name;
+        }
+
+    private:
+        std::vector<std::string> recorderNames;
+        std::string recorderNamesTxt;
+
+        std::string recorderName;
+        int recorderNameId = -1;
+
+        std::string name = "Trigger \"\"";
+    };
+
+    Action TriggerRecorder() {
+        return Action(new TriggerRecorderClass);
+    }
+}
\ No newline at end of file
@@ -28,14 +28,20 @@ public:
         tuneVFOConfig["vfo"] = "Radio";
         tuneVFOConfig["frequency"] = 103500000.0;
 
+        json recTriggerConfig;
+        recTriggerConfig["recorder"] = "Recorder";
+
         auto recStart = sched_action::StartRecorder();
         auto tuneVFO = sched_action::TuneVFO();
+        auto recTrigger = sched_action::TriggerRecorder();
 
         recStart->loadFromConfig(recStartConfig);
         tuneVFO->loadFromConfig(tuneVFOConfig);
+        recTrigger->loadFromConfig(recTriggerConfig);
 
         t.addAction(tuneVFO);
         t.addAction(recStart);
+        t.addAction(recTrigger);
 
         tasks["Test"] = t;
         tasks["Another test"] = t;
@@ -30,4 +30,5 @@ namespace sched_action {
 }
 
 #include <actions/start_recorder.h>
+#include <actions/trigger_recorder.h>
 #include <actions/tune_vfo.h>
\ No newline at end of file
@@ -4,22 +4,26 @@
 #include <module.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
-#include <wavreader.h>
+#include <utils/iq_file.h>
 #include <core.h>
+#include <gui/style.h>
+#include <utils/optionlist.h>
 #include <gui/widgets/file_select.h>
 #include <filesystem>
 #include <regex>
 #include <gui/tuner.h>
 #include <algorithm>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
 SDRPP_MOD_INFO{
     /* Name:            */ "file_source",
-    /* Description:     */ "Wav file source module for SDR++",
+    /* Description:     */ "IQ file source module for SDR++",
     /* Author:          */ "Ryzerth",
-    /* Version:         */ 0, 1, 1,
+    /* Version:         */ 0, 2, 0,
     /* Max instances    */ 1
 };
 
@@ -27,14 +31,38 @@ ConfigManager config;
 
 class FileSourceModule : public ModuleManager::Instance {
 public:
-    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "All Files", "*" }) {
+    FileSourceModule(std::string name) : fileSelect("", { "IQ Files", "*.wav *.w64 *.sigmf-meta *.sigmf-data *.cu8 *.cs8 *.cs16 *.cf32 *.raw *.bin", "All Files", "*" }) {
         this->name = name;
 
         if (core::args["server"].b()) { return; }
 
+        // Define option lists
+        rawFormats.define("cu8", "CU8", SAMPLE_FORMAT_CU8);
+        rawFormats.define("cs8", "CS8", SAMPLE_FORMAT_CS8);
+        rawFormats.define("cs16", "CS16", SAMPLE_FORMAT_CS16);
+        rawFormats.define("cf32", "CF32", SAMPLE_FORMAT_CF32);
+        speeds.define("0.25x", "0.25x", 0.25);
+        speeds.define("0.5x", "0.5x", 0.5);
+        speeds.define("1x", "Real-time", 1.0);
+        speeds.define("2x", "2x", 2.0);
+        speeds.define("4x", "4x", 4.0);
+        speeds.define("8x", "8x", 8.0);
+        speeds.define("16x", "16x", 16.0);
+        speeds.define("max", "Unlimited", 0.0);
+
         config.acquire();
         fileSelect.setPath(config.conf["path"], true);
+        if (config.conf.contains("rawFormat") && rawFormats.keyExists(config.conf["rawFormat"])) {
+            rawFormatId = rawFormats.keyId(config.conf["rawFormat"]);
+        }
+        if (config.conf.contains("rawSampleRate")) {
+            rawSampleRate = config.conf["rawSampleRate"];
+        }
+        if (config.conf.contains("speed") && speeds.keyExists(config.conf["speed"])) {
+            speedId = speeds.keyId(config.conf["speed"]);
+        }
         config.release();
+        speed = speeds.value(speedId);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -90,21 +118,23 @@ private:
     static void start(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (_this->running) { return; }
-        if (_this->reader == NULL) { return; }
+        if (!_this->file.isOpen()) { return; }
         _this->running = true;
-        _this->workerThread = _this->float32Mode ? std::thread(floatWorker, _this) : std::thread(worker, _this);
+        _this->workerThread = std::thread(worker, _this);
         flog::info("FileSourceModule '{0}': Start!", _this->name);
     }
 
     static void stop(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (!_this->running) { return; }
-        if (_this->reader == NULL) { return; }
         _this->stream.stopWriter();
         _this->workerThread.join();
         _this->stream.clearWriteStop();
         _this->running = false;
-        _this->reader->rewind();
+
+        // Apply a seek that the worker didn't get to, the position is kept so playback can resume where it stopped
+        int64_t target = _this->seekRequest.exchange(-1);
+        if (target >= 0) { _this->file.seek(target); }
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
     }
 
@@ -116,68 +146,148 @@ private:
     static void menuHandler(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
 
+        if (_this->running) { style::beginDisabled(); }
+
         if (_this->fileSelect.render("##file_source_" + _this->name)) {
             if (_this->fileSelect.pathIsValid()) {
-                if (_this->reader != NULL) {
-                    _this->reader->close();
-                    delete _this->reader;
-                }
-                try {
-                    _this->reader = new WavReader(_this->fileSelect.path);
-                    if (_this->reader->getSampleRate() == 0) {
-                        _this->reader->close();
-                        delete _this->reader;
-                        _this->reader = NULL;
-                        throw std::runtime_error("Sample rate may not be zero");
-                    }
-                    _this->sampleRate = _this->reader->getSampleRate();
-                    core::setInputSampleRate(_this->sampleRate);
-                    std::string filename = std::filesystem::path(_this->fileSelect.path).filename().string();
-                    _this->centerFreq = _this->getFrequency(filename);
-                    tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", _this->centerFreq);
-                    //gui::freqSelect.minFreq = _this->centerFreq - (_this->sampleRate/2);
-                    //gui::freqSelect.maxFreq = _this->centerFreq + (_this->sampleRate/2);
-                    //gui::freqSelect.limitFreq = true;
-                }
-                catch (const std::exception& e) {
-                    flog::error("Error: {}", e.what());
-                }
+                _this->openFile();
                 config.acquire();
                 config.conf["path"] = _this->fileSelect.path;
                 config.release(true);
             }
         }
 
-        ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
+        // Format of files without a header
+        ImGui::LeftLabel("Raw format");
+        ImGui::FillWidth();
+        if (ImGui::Combo(CONCAT("##file_source_raw_fmt_", _this->name), &_this->rawFormatId, _this->rawFormats.txt)) {
+            if (_this->fileSelect.pathIsValid()) { _this->openFile(); }
+            config.acquire();
+            config.conf["rawFormat"] = _this->rawFormats.key(_this->rawFormatId);
+            config.release(true);
+        }
+
+        ImGui::LeftLabel("Raw samplerate");
+        ImGui::FillWidth();
+        // Only reopen the file once the value is entered, not on every keystroke
+        ImGui::InputInt(CONCAT("##file_source_raw_sr_", _this->name), &_this->rawSampleRate, 0, 0);
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            _this->rawSampleRate = std::max<int>(_this->rawSampleRate, 1000);
+            if (_this->fileSelect.pathIsValid()) { _this->openFile(); }
+            config.acquire();
+            config.conf["rawSampleRate"] = _this->rawSampleRate;
+            config.release(true);
+        }
+
+        if (_this->running) { style::endDisabled(); }
+
+        ImGui::LeftLabel("Speed");
+        ImGui::FillWidth();
+        if (ImGui::Combo(CONCAT("##file_source_speed_", _this->name), &_this->speedId, _this->speeds.txt)) {
+            _this->speed = _this->speeds.value(_this->speedId);
+            config.acquire();
+            config.conf["speed"] = _this->speeds.key(_this->speedId);
+            config.release(true);
+        }
+
+        // Position, dragging the slider scrubs through the file
+        if (_this->file.isOpen()) {
+            double sampleRate = _this->file.getSampleRate();
+            int64_t target = _this->seekRequest;
+            uint64_t pos = (target >= 0) ? target : _this->file.getPosition();
+            float seconds = (double)pos / sampleRate;
+            float duration = (double)_this->file.getSampleCount() / sampleRate;
+            std::string label = formatTime(seconds) + " / " + formatTime(duration);
+            ImGui::FillWidth();
+            if (ImGui::SliderFloat(CONCAT("##file_source_pos_", _this->name), &seconds, 0.0f, duration, label.c_str())) {
+                _this->seek(seconds * sampleRate);
+            }
+        }
     }
 
-    static void worker(void* ctx) {
-        FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
+    void openFile() {
+        file.close();
+        try {
+            file.open(fileSelect.path, rawFormats.value(rawFormatId), rawSampleRate);
+            sampleRate = file.getSampleRate();
+            core::setInputSampleRate(sampleRate);
+            if (file.hasFrequency()) {
+                centerFreq = file.getFrequency();
+            }
+            else {
+                std::string filename = std::filesystem::path(fileSelect.path).filename().string();
+                centerFreq = getFrequency(filename);
+            }
+            tuner::tune(tuner::TUNER_MODE_IQ_ONLY, "", centerFreq);
+            //gui::freqSelect.minFreq = _this->centerFreq - (_this->sampleRate/2);
+            //gui::freqSelect.maxFreq = _this->centerFreq + (_this->sampleRate/2);
+            //gui::freqSelect.limitFreq = true;
+        }
+        catch (const std::exception& e) {
+            flog::error("Error: {}", e.what());
+        }
+    }
 
-        while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
+    void seek(uint64_t sample) {
+        // The worker owns the position while running
+        if (running) {
+            seekRequest = sample;
         }
+        else {
+            file.seek(sample);
+        }
+    }
 
-        delete[] inBuf;
+    static std::string formatTime(double seconds) {
+        char buf[32];
+        int s = seconds;
+        snprintf(buf, sizeof(buf), "%02d:%02d:%02d", s / 3600, (s / 60) % 60, s % 60);
+        return buf;
     }
 
-    static void floatWorker(void* ctx) {
+    static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        dsp::complex_t* inBuf = new dsp::complex_t[blockSize];
+        double sampleRate = std::max<double>(_this->file.getSampleRate(), 1.0);
+        int blockSize = std::clamp<int>(sampleRate / 200.0, 1, STREAM_BUFFER_SIZE);
+
+        // Blocks are paced against a schedule that restarts whenever the speed changes or the position jumps
+        auto begin = std::chrono::steady_clock::now();
+        double sent = 0.0;
+        double currentSpeed = -1.0;
 
         while (true) {
-            _this->reader->readSamples(_this->stream.writeBuf, blockSize * sizeof(dsp::complex_t));
+            int64_t target = _this->seekRequest.exchange(-1);
+            if (target >= 0) {
+                _this->file.seek(target);
+                currentSpeed = -1.0;
+            }
+
+            _this->file.read(_this->stream.writeBuf, blockSize);
             if (!_this->stream.swap(blockSize)) { break; };
-        }
 
-        delete[] inBuf;
+            double spd = _this->speed;
+            if (spd <= 0.0) {
+                currentSpeed = spd;
+                continue;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (spd != currentSpeed) {
+                currentSpeed = spd;
+                begin = now;
+                sent = 0.0;
+            }
+            sent += blockSize;
+            auto next = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(sent / (sampleRate * spd)));
+
+            // If the DSP fell too far behind, don't try to catch up
+            if (now - next > std::chrono::milliseconds(500)) {
+                begin = now;
+                sent = 0.0;
+            }
+            else {
+                std::this_thread::sleep_until(next);
+            }
+        }
     }
 
     double getFrequency(std::string filename) {
@@ -193,7 +303,8 @@ private:
     std::string name;
     dsp::stream<dsp::complex_t> stream;
     SourceManager::SourceHandler handler;
-    WavReader* reader = NULL;
+    IQFile file;
+    std::atomic<int64_t> seekRequest = -1;
     bool running = false;
     bool enabled = true;
     float sampleRate = 1000000;
@@ -201,12 +312,21 @@ private:
 
     double centerFreq = 100000000;
 
-    bool float32Mode = false;
+    OptionList<std::string, SampleFormat> rawFormats;
+    int rawFormatId = 2;
+    int rawSampleRate = 1000000;
+
+    OptionList<std::string, double> speeds;
+    int speedId = 2;
+    std::atomic<double> speed = 1.0;
 };
 
 MOD_EXPORT void _INIT_() {
     json def = json({});
     def["path"] = "";
+    def["rawFormat"] = "cs16";
+    def["rawSampleRate"] = 1000000;
+    def["speed"] = "1x";
     config.setPath(core::args["root"].s() + "/file_source_config.json");
     config.load(def);
     config.enableAutoSave();
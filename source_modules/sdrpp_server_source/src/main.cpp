@@ -35,7 +35,17 @@ public:
         sampleTypeList.define("Int8", dsp::compression::PCM_TYPE_I8);
         sampleTypeList.define("Int16", dsp::compression::PCM_TYPE_I16);
         sampleTypeList.define("Float32", dsp::compression::PCM_TYPE_F32);
+        sampleTypeList.define("BFP4", dsp::compression::PCM_TYPE_BFP4);
+        sampleTypeList.define("BFP6", dsp::compression::PCM_TYPE_BFP6);
+        sampleTypeList.define("BFP8", dsp::compression::PCM_TYPE_BFP8);
+        sampleTypeList.define("BFP10", dsp::compression::PCM_TYPE_BFP10);
+        sampleTypeList.define("BFP12", dsp::compression::PCM_TYPE_BFP12);
         sampleTypeId = sampleTypeList.valueId(dsp::compression::PCM_TYPE_I16);
+        fftWidthList.define(512, "512", 512);
+        fftWidthList.define(1024, "1024", 1024);
+        fftWidthList.define(2048, "2048", 2048);
+        fftWidthList.define(4096, "4096", 4096);
+        fftWidthId = fftWidthList.valueId(1024);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -54,9 +64,30 @@ public:
         config.release();
 
         sigpath::sourceManager.registerSource("SDR++ Server", &handler);
+
+        // Mirror the local VFOs on the server when not receiving the full baseband
+        vfoChangeHandler.handler = vfoChanged;
+        vfoChangeHandler.ctx = this;
+        vfoRemoveHandler.handler = vfoRemoved;
+        vfoRemoveHandler.ctx = this;
+        sigpath::iqFrontEnd.onVFOChange.bindHandler(&vfoChangeHandler);
+        sigpath::iqFrontEnd.onVFORemove.bindHandler(&vfoRemoveHandler);
+
+        // Keep the spectrum lines matching the waterfall as it's zoomed, moved or its FFT settings change
+        fftRedrawHandler.handler = fftRedraw;
+        fftRedrawHandler.ctx = this;
+        gui::waterfall.onFFTRedraw.bindHandler(&fftRedrawHandler);
+        handlersBound = true;
     }
 
     ~SDRPPServerSourceModule() {
+        // Unbind whatever the constructor bound before anything else, the events outlive this instance
+        if (handlersBound) {
+            sigpath::iqFrontEnd.onVFOChange.unbindHandler(&vfoChangeHandler);
+            sigpath::iqFrontEnd.onVFORemove.unbindHandler(&vfoRemoveHandler);
+            gui::waterfall.onFFTRedraw.unbindHandler(&fftRedrawHandler);
+            handlersBound = false;
+        }
         stop(this);
         sigpath::sourceManager.unregisterSource("SDR++ Server");
     }
@@ -96,12 +127,18 @@ private:
             core::setInputSampleRate(_this->client->getSampleRate());
         }
         gui::mainWindow.playButtonLocked = !(_this->client && _this->client->isOpen());
+        _this->selected = true;
+        _this->syncAllVFOs();
+        _this->fftSettings = {};
+        _this->updateFFT();
         flog::info("SDRPPServerSourceModule '{0}': Menu Select!", _this->name);
     }
 
     static void menuDeselected(void* ctx) {
         SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
         gui::mainWindow.playButtonLocked = false;
+        _this->selected = false;
+        _this->clearRemoteVFOs(true);
         flog::info("SDRPPServerSourceModule '{0}': Menu Deselect!", _this->name);
     }
 
@@ -199,10 +236,34 @@ private:
                 config.release(true);
             }
 
-            bool dummy = true;
-            style::beginDisabled();
-            ImGui::Checkbox("Full IQ", &dummy);
-            style::endDisabled();
+            if (ImGui::Checkbox("Full IQ", &_this->fullIQ)) {
+                // Switch the VFOs between local and server-side DDC
+                if (_this->fullIQ) {
+                    _this->clearRemoteVFOs(true);
+                    _this->client->setFullIQ(true);
+                }
+                else {
+                    _this->client->setFullIQ(false);
+                    _this->syncAllVFOs();
+                }
+
+                // Save config
+                config.acquire();
+                config.conf["servers"][_this->devConfName]["fullIQ"] = _this->fullIQ;
+                config.release(true);
+            }
+
+            // Without the baseband, the waterfall is drawn from spectrum lines and VFOs are run by the server
+            if (!_this->fullIQ) {
+                ImGui::LeftLabel("Panorama width");
+                ImGui::FillWidth();
+                if (ImGui::Combo("##sdrpp_srv_source_fft_width", &_this->fftWidthId, _this->fftWidthList.txt)) {
+                    config.acquire();
+                    config.conf["servers"][_this->devConfName]["fftWidth"] = _this->fftWidthList.key(_this->fftWidthId);
+                    config.release(true);
+                    _this->updateFFT();
+                }
+            }
 
             // Calculate datarate
             _this->frametimeCounter += ImGui::GetIO().DeltaTime;
@@ -216,6 +277,14 @@ private:
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Connected (%.3f Mbit/s)", _this->datarate);
 
+            server::ServerStats stats;
+            if (_this->client->getStats(stats)) {
+                if (_this->compression && stats.compressionRatio > 0.0f) {
+                    ImGui::Text("Compression: %.2fx (level %d, %d%% CPU)", stats.compressionRatio, (int)stats.compressionLevel, (int)stats.cpuLoad);
+                }
+                ImGui::Text("Server queue: %u KB (%u dropped)", stats.queuedBytes / 1024, stats.droppedFrames);
+            }
+
             ImGui::CollapsingHeader("Source [REMOTE]", ImGuiTreeNodeFlags_DefaultOpen);
 
             _this->client->showMenu();
@@ -231,10 +300,121 @@ private:
         return client && client->isOpen();
     }
 
+    void updateFFT() {
+        if (!selected || !connected()) { return; }
+
+        // Follow the local FFT settings and the visible part of the waterfall
+        server::FFTSettings settings = {};
+        settings.enabled = !fullIQ;
+        settings.deltaCoding = compression;
+        settings.width = fftWidthList.value(fftWidthId);
+        settings.size = std::clamp<int>(sigpath::iqFrontEnd.getFFTSize(), SERVER_MIN_FFT_SIZE, SERVER_MAX_FFT_SIZE);
+        settings.rate = std::clamp<float>(sigpath::iqFrontEnd.getFFTRate(), 1.0f, SERVER_MAX_FFT_RATE);
+        settings.offset = gui::waterfall.getViewOffset();
+        settings.bandwidth = gui::waterfall.getViewBandwidth();
+
+        // Only send what changed
+        if (!memcmp(&settings, &fftSettings, sizeof(server::FFTSettings))) { return; }
+        client->setFFT(settings);
+        fftSettings = settings;
+    }
+
+    void syncVFO(const std::string& name) {
+        if (!selected || fullIQ || !connected()) { return; }
+        server::VFOSettings settings;
+        if (!sigpath::iqFrontEnd.getVFOParams(name, settings.offset, settings.sampleRate, settings.bandwidth)) { return; }
+
+        // Give the VFO an ID the first time it's seen
+        {
+            std::lock_guard<std::mutex> lck(remoteVFOMtx);
+            auto it = remoteVFOIds.find(name);
+            if (it == remoteVFOIds.end()) {
+                settings.id = nextVFOId++;
+                remoteVFOIds[name] = settings.id;
+                remoteVFOStreams[settings.id] = sigpath::iqFrontEnd.getVFOOutput(name);
+            }
+            else {
+                settings.id = it->second;
+            }
+        }
+        client->setVFO(settings);
+    }
+
+    void syncAllVFOs() {
+        for (const auto& name : sigpath::iqFrontEnd.getVFONames()) { syncVFO(name); }
+    }
+
+    void clearRemoteVFOs(bool removeFromServer) {
+        std::lock_guard<std::mutex> lck(remoteVFOMtx);
+        if (removeFromServer && connected()) {
+            for (auto& [name, id] : remoteVFOIds) { client->removeVFO(id); }
+        }
+        remoteVFOIds.clear();
+        remoteVFOStreams.clear();
+    }
+
+    static void vfoChanged(std::string name, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+        _this->syncVFO(name);
+    }
+
+    static void vfoRemoved(std::string name, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+        std::lock_guard<std::mutex> lck(_this->remoteVFOMtx);
+        auto it = _this->remoteVFOIds.find(name);
+        if (it == _this->remoteVFOIds.end()) { return; }
+        if (_this->connected()) { _this->client->removeVFO(it->second); }
+        _this->remoteVFOStreams.erase(it->second);
+        _this->remoteVFOIds.erase(it);
+    }
+
+    static void vfoHandler(uint32_t id, dsp::complex_t* data, int count, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+
+        // Without baseband the local DDC is idle, so the server's samples are written in its place
+        std::lock_guard<std::mutex> lck(_this->remoteVFOMtx);
+        auto it = _this->remoteVFOStreams.find(id);
+        if (it == _this->remoteVFOStreams.end() || !it->second) { return; }
+        dsp::stream<dsp::complex_t>* out = it->second;
+        if (!out->reserve(count)) { return; }
+        memcpy(out->writeBuf, data, count * sizeof(dsp::complex_t));
+        out->swap(count);
+    }
+
+    static void fftRedraw(ImGui::WaterFall::FFTRedrawArgs args, void* ctx) {
+        SDRPPServerSourceModule* _this = (SDRPPServerSourceModule*)ctx;
+        _this->updateFFT();
+    }
+
+    static void fftHandler(float* line, int width, double offset, double bandwidth, void* ctx) {
+        float* buf = gui::waterfall.getFFTBuffer();
+        if (buf) {
+            int size = gui::waterfall.getRawFFTSize();
+            double binWidth = gui::waterfall.getBandwidth() / (double)size;
+
+            // Bins outside of the window covered by the line are set to its lowest level
+            float floorLvl = line[0];
+            for (int i = 1; i < width; i++) { floorLvl = std::min<float>(floorLvl, line[i]); }
+
+            // Spread the line over the FFT bins it covers
+            double start = offset - (bandwidth / 2.0);
+            double scale = (double)width / bandwidth;
+            for (int i = 0; i < size; i++) {
+                int id = floor((((double)(i - (size / 2)) * binWidth) - start) * scale);
+                buf[i] = (id >= 0 && id < width) ? line[id] : floorLvl;
+            }
+        }
+        gui::waterfall.pushFFT();
+    }
+
     void tryConnect() {
         try {
             if (client) { client.reset(); }
             client = server::connect(hostname, port, &stream);
+            client->fftHandler = fftHandler;
+            client->fftHandlerCtx = this;
+            client->vfoHandler = vfoHandler;
+            client->vfoHandlerCtx = this;
             deviceInit();
         }
         catch (const std::exception& e) {
@@ -258,10 +438,26 @@ private:
         if (config.conf["servers"][devConfName].contains("compression")) {
             compression = config.conf["servers"][devConfName]["compression"];
         }
+        fullIQ = false;
+        if (config.conf["servers"][devConfName].contains("fullIQ")) {
+            fullIQ = config.conf["servers"][devConfName]["fullIQ"];
+        }
+        fftWidthId = fftWidthList.valueId(1024);
+        if (config.conf["servers"][devConfName].contains("fftWidth")) {
+            int width = config.conf["servers"][devConfName]["fftWidth"];
+            if (fftWidthList.keyExists(width)) { fftWidthId = fftWidthList.keyId(width); }
+        }
 
         // Set settings
         client->setSampleType(sampleTypeList[sampleTypeId]);
         client->setCompression(compression);
+        client->setFullIQ(fullIQ);
+        fftSettings = {};
+        updateFFT();
+
+        // The server drops its VFOs on connection
+        clearRemoteVFOs(false);
+        syncAllVFOs();
     }
 
     std::string name;
@@ -284,6 +480,21 @@ private:
     OptionList<std::string, dsp::compression::PCMType> sampleTypeList;
     int sampleTypeId;
     bool compression = false;
+    bool fullIQ = false;
+    bool selected = false;
+
+    EventHandler<std::string> vfoChangeHandler;
+    EventHandler<std::string> vfoRemoveHandler;
+    std::mutex remoteVFOMtx;
+    std::map<std::string, uint32_t> remoteVFOIds;
+    std::map<uint32_t, dsp::stream<dsp::complex_t>*> remoteVFOStreams;
+    uint32_t nextVFOId = 0;
+
+    OptionList<int, int> fftWidthList;
+    int fftWidthId;
+    server::FFTSettings fftSettings = {};
+    EventHandler<ImGui::WaterFall::FFTRedrawArgs> fftRedrawHandler;
+    bool handlersBound = false;
 
     std::shared_ptr<server::Client> client;
 };
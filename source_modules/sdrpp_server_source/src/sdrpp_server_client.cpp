@@ -14,6 +14,10 @@ namespace server {
         // Allocate buffers
         rbuffer = new uint8_t[SERVER_MAX_PACKET_SIZE];
         sbuffer = new uint8_t[SERVER_MAX_PACKET_SIZE];
+        fftCodeBuf = new uint8_t[sizeof(dsp::compression::SpectrumHeader) + SERVER_MAX_FFT_WIDTH];
+        fftLine = dsp::buffer::alloc<float>(SERVER_MAX_FFT_WIDTH);
+        vfoDecompBuf = new uint8_t[STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8];
+        vfoSamples = dsp::buffer::alloc<dsp::complex_t>(STREAM_BUFFER_SIZE);
 
         // Initialize headers
         r_pkt_hdr = (PacketHeader*)rbuffer;
@@ -63,6 +67,10 @@ namespace server {
         ZSTD_freeDCtx(dctx);
         delete[] rbuffer;
         delete[] sbuffer;
+        delete[] fftCodeBuf;
+        dsp::buffer::free(fftLine);
+        delete[] vfoDecompBuf;
+        dsp::buffer::free(vfoSamples);
     }
 
     void Client::showMenu() {
@@ -133,6 +141,30 @@ namespace server {
         sendCommand(COMMAND_SET_COMPRESSION, 1);
     }
 
+    void Client::setFFT(const FFTSettings& settings) {
+        if (!isOpen()) { return; }
+        memcpy(s_cmd_data, &settings, sizeof(FFTSettings));
+        sendCommand(COMMAND_SET_FFT, sizeof(FFTSettings));
+    }
+
+    void Client::setFullIQ(bool enabled) {
+        if (!isOpen()) { return; }
+        s_cmd_data[0] = enabled;
+        sendCommand(COMMAND_SET_FULL_IQ, 1);
+    }
+
+    void Client::setVFO(const VFOSettings& settings) {
+        if (!isOpen()) { return; }
+        memcpy(s_cmd_data, &settings, sizeof(VFOSettings));
+        sendCommand(COMMAND_SET_VFO, sizeof(VFOSettings));
+    }
+
+    void Client::removeVFO(uint32_t id) {
+        if (!isOpen()) { return; }
+        memcpy(s_cmd_data, &id, sizeof(uint32_t));
+        sendCommand(COMMAND_REMOVE_VFO, sizeof(uint32_t));
+    }
+
     void Client::start() {
         if (!isOpen()) { return; }
         sendCommand(COMMAND_START, 0);
@@ -161,6 +193,12 @@ namespace server {
         return sock && sock->isOpen();
     }
 
+    bool Client::getStats(ServerStats& stats) {
+        std::lock_guard<std::mutex> lck(statsMtx);
+        stats = serverStats;
+        return statsReceived;
+    }
+
     void Client::worker() {
         while (true) {
             // Receive header
@@ -183,6 +221,11 @@ namespace server {
                     currentSampleRate = *(double*)r_cmd_data;
                     core::setInputSampleRate(currentSampleRate);
                 }
+                else if (r_cmd_hdr->cmd == COMMAND_SET_STATS && r_pkt_hdr->size == sizeof(PacketHeader) + sizeof(CommandHeader) + sizeof(ServerStats)) {
+                    std::lock_guard<std::mutex> lck(statsMtx);
+                    memcpy(&serverStats, r_cmd_data, sizeof(ServerStats));
+                    statsReceived = true;
+                }
                 else if (r_cmd_hdr->cmd == COMMAND_DISCONNECT) {
                     flog::error("Asked to disconnect by the server");
                     serverBusy = true;
@@ -226,6 +269,46 @@ namespace server {
                     if (!decompIn.swap(outCount)) { break; }
                 };
             }
+            else if (r_pkt_hdr->type == PACKET_TYPE_FFT && r_pkt_hdr->size >= sizeof(PacketHeader) + sizeof(FFTHeader)) {
+                FFTHeader* fhdr = (FFTHeader*)r_pkt_data;
+                uint8_t* data = &r_pkt_data[sizeof(FFTHeader)];
+                int len = r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(FFTHeader);
+
+                // Decompress if needed
+                if (fhdr->flags & FFT_FLAG_COMPRESSED) {
+                    size_t outCount = ZSTD_decompressDCtx(dctx, fftCodeBuf, sizeof(dsp::compression::SpectrumHeader) + SERVER_MAX_FFT_WIDTH, data, len);
+                    if (ZSTD_isError(outCount)) { continue; }
+                    data = fftCodeBuf;
+                    len = outCount;
+                }
+
+                // Decode and hand over the line
+                int width = dsp::compression::decodeSpectrum(data, len, fftLine, SERVER_MAX_FFT_WIDTH);
+                if (width > 0 && fftHandler) {
+                    fftHandler(fftLine, width, fhdr->offset, fhdr->bandwidth, fftHandlerCtx);
+                }
+            }
+            else if (r_pkt_hdr->type == PACKET_TYPE_VFO && r_pkt_hdr->size >= sizeof(PacketHeader) + sizeof(VFOHeader)) {
+                VFOHeader* vhdr = (VFOHeader*)r_pkt_data;
+                uint8_t* data = &r_pkt_data[sizeof(VFOHeader)];
+                int len = r_pkt_hdr->size - sizeof(PacketHeader) - sizeof(VFOHeader);
+
+                // Decompress if needed
+                int maxLen = STREAM_BUFFER_SIZE * sizeof(dsp::complex_t) + 8;
+                if (vhdr->flags & VFO_FLAG_COMPRESSED) {
+                    size_t outCount = ZSTD_decompressDCtx(dctx, vfoDecompBuf, maxLen, data, len);
+                    if (ZSTD_isError(outCount)) { continue; }
+                    data = vfoDecompBuf;
+                    len = outCount;
+                }
+                if (len < 8 || len > maxLen) { continue; }
+
+                // Convert back to complex samples and hand them over
+                int count = dsp::compression::SampleStreamDecompressor::process(len, data, vfoSamples);
+                if (count && vfoHandler) {
+                    vfoHandler(vhdr->id, vfoSamples, count, vfoHandlerCtx);
+                }
+            }
             else if (r_pkt_hdr->type == PACKET_TYPE_ERROR) {
                 flog::error("SDR++ Server Error: {0}", rbuffer[sizeof(PacketHeader)]);
             }
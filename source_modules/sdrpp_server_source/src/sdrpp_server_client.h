@@ -9,6 +9,7 @@
 #include <map>
 #include <vector>
 #include <dsp/compression/sample_stream_decompressor.h>
+#include <dsp/compression/spectrum_codec.h>
 #include <dsp/sink.h>
 #include <dsp/routing/stream_link.h>
 #include <zstd.h>
@@ -90,15 +91,34 @@ namespace server {
         void setSampleType(dsp::compression::PCMType type);
         void setCompression(bool enabled);
 
+        // Ask the server for spectrum lines instead of, or on top of, the baseband
+        void setFFT(const FFTSettings& settings);
+        void setFullIQ(bool enabled);
+
+        // Run a DDC on the server, its samples are given to vfoHandler
+        void setVFO(const VFOSettings& settings);
+        void removeVFO(uint32_t id);
+
         void start();
         void stop();
 
         void close();
         bool isOpen();
 
+        // Latest statistics sent by the server, returns false if none were received yet
+        bool getStats(ServerStats& stats);
+
         int bytes = 0;
         bool serverBusy = false;
 
+        // Called from the network thread for every spectrum line received
+        void (*fftHandler)(float* line, int width, double offset, double bandwidth, void* ctx) = NULL;
+        void* fftHandlerCtx = NULL;
+
+        // Called from the network thread for every block of samples received from a server VFO
+        void (*vfoHandler)(uint32_t id, dsp::complex_t* data, int count, void* ctx) = NULL;
+        void* vfoHandlerCtx = NULL;
+
     private:
         void worker();
 
@@ -123,6 +143,10 @@ namespace server {
 
         uint8_t* rbuffer = NULL;
         uint8_t* sbuffer = NULL;
+        uint8_t* fftCodeBuf = NULL;
+        float* fftLine = NULL;
+        uint8_t* vfoDecompBuf = NULL;
+        dsp::complex_t* vfoSamples = NULL;
 
         PacketHeader* r_pkt_hdr = NULL;
         uint8_t* r_pkt_data = NULL;
@@ -142,6 +166,10 @@ namespace server {
         std::thread workerThread;
 
         double currentSampleRate = 1000000.0;
+
+        std::mutex statsMtx;
+        ServerStats serverStats;
+        bool statsReceived = false;
     };
 
     std::shared_ptr<Client> connect(std::string host, uint16_t port, dsp::stream<dsp::complex_t>* out);
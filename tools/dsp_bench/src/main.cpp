@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <math.h>
+#include <random>
+#include <new>
+#include <string>
+#include <vector>
+#include <functional>
+#include <fstream>
+#include <json.hpp>
+#include <version.h>
+#include <command_args.h>
+#include <dsp/bench/block_bench.h>
+#include <dsp/filter/fir.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/channel/rx_vfo.h>
+#include <dsp/demod/am.h>
+#include <dsp/demod/fm.h>
+#include <dsp/demod/ssb.h>
+#include <dsp/demod/quadrature.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/loop/agc.h>
+#include <dsp/clock_recovery/mm.h>
+#include <dsp/clock_recovery/fd.h>
+#include <dsp/taps/windowed_sinc.h>
+#include <dsp/window/nuttall.h>
+#include <dsp/scheduler.h>
+#include <dsp/compression/sample_stream_compressor.h>
+#include <dsp/compression/sample_stream_decompressor.h>
+#include <zstd.h>
+
+using nlohmann::json;
+
+// Count every heap allocation made through operator new, buffers allocated with volk aren't seen
+void* operator new(size_t size) {
+    dsp::bench::allocCount++;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) { throw std::bad_alloc(); }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept {
+    free(ptr);
+}
+
+struct BenchCase {
+    std::string block;
+    json params;
+    std::function<dsp::bench::Result(int bufferSize, int durationMs)> run;
+};
+
+// Parameter matrix
+const std::vector<int> bufferSizes = { 1024, 16384, 131072 };
+const std::vector<int> tapCounts = { 32, 128, 512 };
+const std::vector<int> decimations = { 2, 8 };
+const std::vector<unsigned int> powerRatios = { 4, 64, 1024 };
+const std::vector<std::pair<double, double>> resampRates = { { 2.4e6, 250e3 }, { 250e3, 48e3 }, { 48e3, 44.1e3 } };
+const std::vector<std::vector<double>> vfoParams = { { 2.4e6, 250e3, 200e3 }, { 2.4e6, 50e3, 12.5e3 }, { 8e6, 48e3, 3e3 } };
+const std::vector<double> audioRates = { 24e3, 48e3, 250e3 };
+const std::vector<double> omegas = { 2.0, 10.0 };
+const std::vector<std::pair<std::string, dsp::compression::PCMType>> pcmTypes = {
+    { "i8", dsp::compression::PCM_TYPE_I8 },
+    { "i16", dsp::compression::PCM_TYPE_I16 },
+    { "f32", dsp::compression::PCM_TYPE_F32 },
+    { "bfp4", dsp::compression::PCM_TYPE_BFP4 },
+    { "bfp6", dsp::compression::PCM_TYPE_BFP6 },
+    { "bfp8", dsp::compression::PCM_TYPE_BFP8 },
+    { "bfp10", dsp::compression::PCM_TYPE_BFP10 },
+    { "bfp12", dsp::compression::PCM_TYPE_BFP12 }
+};
+
+dsp::sched::Pool pool;
+
+// Lowpass with an exact tap count, unlike taps::lowPass()
+dsp::tap<float> benchTaps(int count, double decimation = 2.0) {
+    return dsp::taps::windowedSinc<float>(count, DB_M_PI / decimation, dsp::window::nuttall);
+}
+
+void addFilterCases(std::vector<BenchCase>& cases) {
+    for (int tc : tapCounts) {
+        cases.push_back({ "fir_f32", { { "taps", tc } }, [tc](int bufferSize, int durationMs) {
+            dsp::tap<float> taps = benchTaps(tc);
+            dsp::filter::FIR<float, float> fir(NULL, taps);
+            auto res = dsp::bench::benchmarkProcess<float, float>([&](int count, float* in, float* out) {
+                return fir.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+            dsp::taps::free(taps);
+            return res;
+        } });
+
+        cases.push_back({ "fir_c32", { { "taps", tc } }, [tc](int bufferSize, int durationMs) {
+            dsp::tap<float> taps = benchTaps(tc);
+            dsp::filter::FIR<dsp::complex_t, float> fir(NULL, taps);
+            auto res = dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                return fir.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+            dsp::taps::free(taps);
+            return res;
+        } });
+
+        for (int decim : decimations) {
+            cases.push_back({ "decimating_fir_c32", { { "taps", tc }, { "decimation", decim } }, [tc, decim](int bufferSize, int durationMs) {
+                dsp::tap<float> taps = benchTaps(tc, decim);
+                dsp::filter::DecimatingFIR<dsp::complex_t, float> fir(NULL, taps, decim);
+                auto res = dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                    return fir.process(count, in, out);
+                }, bufferSize, bufferSize, durationMs);
+                dsp::taps::free(taps);
+                return res;
+            } });
+        }
+    }
+}
+
+void addMultirateCases(std::vector<BenchCase>& cases) {
+    for (unsigned int ratio : powerRatios) {
+        for (bool parallel : { false, true }) {
+            cases.push_back({ "power_decimator_c32", { { "ratio", ratio }, { "threads", parallel ? pool.getThreadCount() : 1 } }, [ratio, parallel](int bufferSize, int durationMs) {
+                dsp::multirate::PowerDecimator<dsp::complex_t> decim(NULL, ratio);
+                if (parallel) { decim.setWorkerPool(&pool); }
+                return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                    return decim.process(count, in, out);
+                }, bufferSize, bufferSize, durationMs);
+            } });
+        }
+    }
+
+    for (const auto& [inSr, outSr] : resampRates) {
+        cases.push_back({ "rational_resampler_c32", { { "in_samplerate", inSr }, { "out_samplerate", outSr } }, [inSr = inSr, outSr = outSr](int bufferSize, int durationMs) {
+            dsp::multirate::RationalResampler<dsp::complex_t> resamp(NULL, inSr, outSr);
+            int outSize = std::max<int>(bufferSize, ceil((double)bufferSize * outSr / inSr)) + 16;
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                return resamp.process(count, in, out);
+            }, bufferSize, outSize, durationMs);
+        } });
+    }
+
+    for (const auto& p : vfoParams) {
+        double inSr = p[0], outSr = p[1], bw = p[2];
+        cases.push_back({ "rx_vfo", { { "in_samplerate", inSr }, { "out_samplerate", outSr }, { "bandwidth", bw } }, [inSr, outSr, bw](int bufferSize, int durationMs) {
+            dsp::channel::RxVFO vfo(NULL, inSr, outSr, bw, inSr / 8.0);
+            int outSize = std::max<int>(bufferSize, ceil((double)bufferSize * outSr / inSr)) + 16;
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                return vfo.process(count, in, out);
+            }, bufferSize, outSize, durationMs);
+        } });
+    }
+}
+
+void addDemodCases(std::vector<BenchCase>& cases) {
+    for (double sr : audioRates) {
+        cases.push_back({ "am_demod", { { "samplerate", sr } }, [sr](int bufferSize, int durationMs) {
+            dsp::demod::AM<dsp::stereo_t> demod(NULL, dsp::demod::AM<dsp::stereo_t>::CARRIER, sr / 5.0, 50.0 / sr, 5.0 / sr, 100.0 / sr, sr);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::stereo_t>([&](int count, dsp::complex_t* in, dsp::stereo_t* out) {
+                return demod.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+
+        cases.push_back({ "fm_demod", { { "samplerate", sr } }, [sr](int bufferSize, int durationMs) {
+            dsp::demod::FM<dsp::stereo_t> demod;
+            demod.init(NULL, sr, sr / 4.0, true, false);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::stereo_t>([&](int count, dsp::complex_t* in, dsp::stereo_t* out) {
+                return demod.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+
+        cases.push_back({ "ssb_demod", { { "samplerate", sr } }, [sr](int bufferSize, int durationMs) {
+            dsp::demod::SSB<dsp::stereo_t> demod(NULL, dsp::demod::SSB<dsp::stereo_t>::USB, sr / 8.0, sr, 50.0 / sr, 5.0 / sr);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::stereo_t>([&](int count, dsp::complex_t* in, dsp::stereo_t* out) {
+                return demod.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+
+        cases.push_back({ "quadrature_demod", { { "samplerate", sr } }, [sr](int bufferSize, int durationMs) {
+            dsp::demod::Quadrature demod(NULL, sr / 4.0, sr);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, float>([&](int count, dsp::complex_t* in, float* out) {
+                return demod.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+    }
+
+    // Broadcast FM only makes sense at its usual IF rate
+    for (bool stereo : { false, true }) {
+        cases.push_back({ "broadcast_fm_demod", { { "samplerate", 250e3 }, { "stereo", stereo } }, [stereo](int bufferSize, int durationMs) {
+            dsp::demod::BroadcastFM demod(NULL, 75e3, 250e3, stereo);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::stereo_t>([&](int count, dsp::complex_t* in, dsp::stereo_t* out) {
+                int rdsCount;
+                return demod.process(count, in, out, rdsCount);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+    }
+}
+
+void addLoopCases(std::vector<BenchCase>& cases) {
+    for (double sr : audioRates) {
+        cases.push_back({ "agc_f32", { { "samplerate", sr } }, [sr](int bufferSize, int durationMs) {
+            dsp::loop::AGC<float> agc(NULL, 1.0, 50.0 / sr, 5.0 / sr, 10e6, 10.0);
+            return dsp::bench::benchmarkProcess<float, float>([&](int count, float* in, float* out) {
+                return agc.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+
+        cases.push_back({ "agc_c32", { { "samplerate", sr } }, [sr](int bufferSize, int durationMs) {
+            dsp::loop::AGC<dsp::complex_t> agc(NULL, 1.0, 50.0 / sr, 5.0 / sr, 10e6, 10.0);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                return agc.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+    }
+
+    for (double omega : omegas) {
+        cases.push_back({ "mm_clock_recovery_c32", { { "omega", omega } }, [omega](int bufferSize, int durationMs) {
+            dsp::clock_recovery::MM<dsp::complex_t> recov(NULL, omega, 1e-6, 0.01, 0.01);
+            return dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                return recov.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+
+        cases.push_back({ "fd_clock_recovery_f32", { { "omega", omega } }, [omega](int bufferSize, int durationMs) {
+            dsp::clock_recovery::FD recov(NULL, omega, 1e-6, 0.01, 0.01);
+            return dsp::bench::benchmarkProcess<float, float>([&](int count, float* in, float* out) {
+                return recov.process(count, in, out);
+            }, bufferSize, bufferSize, durationMs);
+        } });
+    }
+}
+
+void addCompressionCases(std::vector<BenchCase>& cases) {
+    for (const auto& [name, type] : pcmTypes) {
+        dsp::compression::PCMType t = type;
+        cases.push_back({ "sample_stream_compressor", { { "type", name } }, [t](int bufferSize, int durationMs) {
+            return dsp::bench::benchmarkProcess<dsp::complex_t, uint8_t>([&](int count, dsp::complex_t* in, uint8_t* out) {
+                return dsp::compression::SampleStreamCompressor::process(count, t, in, out);
+            }, bufferSize, (bufferSize * sizeof(dsp::complex_t)) + 8, durationMs);
+        } });
+
+        // Decode a buffer encoded beforehand, the random input of the benchmark isn't a valid stream
+        cases.push_back({ "sample_stream_decompressor", { { "type", name } }, [t](int bufferSize, int durationMs) {
+            dsp::complex_t* samples = dsp::buffer::alloc<dsp::complex_t>(bufferSize);
+            uint8_t* encoded = dsp::buffer::alloc<uint8_t>((bufferSize * sizeof(dsp::complex_t)) + 8);
+            dsp::bench::randomFill(samples, bufferSize);
+            int len = dsp::compression::SampleStreamCompressor::process(bufferSize, t, samples, encoded);
+            auto res = dsp::bench::benchmarkProcess<dsp::complex_t, dsp::complex_t>([&](int count, dsp::complex_t* in, dsp::complex_t* out) {
+                return dsp::compression::SampleStreamDecompressor::process(len, encoded, out);
+            }, bufferSize, bufferSize, durationMs);
+            dsp::buffer::free(samples);
+            dsp::buffer::free(encoded);
+            return res;
+        } });
+    }
+}
+
+/**
+ * Encode and decode test signals with every sample type and report the bits per complex sample, with and
+ * without zstd on top, and the SNR of the noise after decoding, measured outside of the bursts. The bursty
+ * signal adds a carrier 60dB above the noise for 1024 samples out of every 10240, so most buffers have one.
+ */
+json measureCodecs(int sampleCount, int bufferSize) {
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, sqrtf(0.5f));
+    std::vector<dsp::complex_t> noise(sampleCount);
+    for (auto& s : noise) { s = { dist(rng), dist(rng) }; }
+
+    std::vector<std::pair<std::string, std::vector<dsp::complex_t>>> signals;
+    signals.push_back({ "noise", noise });
+    std::vector<dsp::complex_t> bursts = noise;
+    for (int i = 0; i < sampleCount; i++) {
+        if ((i % 10240) >= 1024) { continue; }
+        float phase = 0.1f * (float)i;
+        bursts[i].re += 1000.0f * cosf(phase);
+        bursts[i].im += 1000.0f * sinf(phase);
+    }
+    signals.push_back({ "bursts", bursts });
+
+    uint8_t* encoded = dsp::buffer::alloc<uint8_t>((bufferSize * sizeof(dsp::complex_t)) + 8);
+    size_t zBound = ZSTD_compressBound((bufferSize * sizeof(dsp::complex_t)) + 8);
+    uint8_t* zbuf = dsp::buffer::alloc<uint8_t>(zBound);
+    dsp::complex_t* decoded = dsp::buffer::alloc<dsp::complex_t>(bufferSize);
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+
+    json table = json::array();
+    for (const auto& [sigName, signal] : signals) {
+        bool bursty = (sigName == "bursts");
+        for (const auto& [typeName, type] : pcmTypes) {
+            uint64_t bytes = 0;
+            uint64_t zbytes = 0;
+            double noisePower = 0.0;
+            double errorPower = 0.0;
+            for (int i = 0; i + bufferSize <= sampleCount; i += bufferSize) {
+                int len = dsp::compression::SampleStreamCompressor::process(bufferSize, type, &signal[i], encoded);
+                bytes += len;
+                size_t zlen = ZSTD_compressCCtx(cctx, zbuf, zBound, encoded, len, 1);
+                zbytes += ZSTD_isError(zlen) ? len : zlen;
+                dsp::compression::SampleStreamDecompressor::process(len, encoded, decoded);
+                for (int j = 0; j < bufferSize; j++) {
+                    if (bursty && ((i + j) % 10240) < 1024) { continue; }
+                    float er = decoded[j].re - signal[i + j].re;
+                    float ei = decoded[j].im - signal[i + j].im;
+                    errorPower += (er * er) + (ei * ei);
+                    noisePower += (noise[i + j].re * noise[i + j].re) + (noise[i + j].im * noise[i + j].im);
+                }
+            }
+
+            int used = (sampleCount / bufferSize) * bufferSize;
+            json r;
+            r["signal"] = sigName;
+            r["type"] = typeName;
+            r["bits_per_sample"] = (double)bytes * 8.0 / (double)used;
+            r["bits_per_sample_zstd"] = (double)zbytes * 8.0 / (double)used;
+            r["snr_db"] = 10.0 * log10(noisePower / std::max<double>(errorPower, 1e-30));
+            table.push_back(r);
+            fprintf(stderr, "%s %s: %.2f bits (%.2f with zstd), %.1f dB\n", sigName.c_str(), typeName.c_str(), (double)r["bits_per_sample"], (double)r["bits_per_sample_zstd"], (double)r["snr_db"]);
+        }
+    }
+
+    ZSTD_freeCCtx(cctx);
+    dsp::buffer::free(encoded);
+    dsp::buffer::free(zbuf);
+    dsp::buffer::free(decoded);
+    return table;
+}
+
+/**
+ * Round trip every BFP type through blocks ranging from normal noise down to denormal levels. Returns false if a
+ * decoded sample isn't finite or is further from the input than the quantization allows. A block that corrupts
+ * the bitstream shows up as errors in the normal blocks that follow it in the same packet.
+ */
+bool checkCodecRoundTrip() {
+    const float levels[] = { 1.0f, 1e-39f, 1.0f, 1e-36f, 1.0f, 1e-30f, 1.0f, 1e-3f, 1.0f };
+    const int levelCount = sizeof(levels) / sizeof(float);
+    int count = levelCount * BFP_BLOCK_SIZE;
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0.0f, sqrtf(0.5f));
+    std::vector<dsp::complex_t> signal(count);
+    for (int i = 0; i < count; i++) {
+        float level = levels[i / BFP_BLOCK_SIZE];
+        signal[i] = { dist(rng) * level, dist(rng) * level };
+    }
+
+    uint8_t* encoded = dsp::buffer::alloc<uint8_t>((count * sizeof(dsp::complex_t)) + 8);
+    dsp::complex_t* decoded = dsp::buffer::alloc<dsp::complex_t>(count);
+    bool ok = true;
+    for (const auto& [typeName, type] : pcmTypes) {
+        if (!dsp::compression::isBFPType(type)) { continue; }
+        float qmax = (float)((1 << (dsp::compression::bfpBits(type) - 1)) - 1);
+        int len = dsp::compression::SampleStreamCompressor::process(count, type, signal.data(), encoded);
+        if (dsp::compression::SampleStreamDecompressor::process(len, encoded, decoded) != count) {
+            fprintf(stderr, "%s: round trip didn't decode every sample\n", typeName.c_str());
+            ok = false;
+            continue;
+        }
+
+        for (int b = 0; b < levelCount; b++) {
+            float peak = 0.0f;
+            float maxErr = 0.0f;
+            bool finite = true;
+            for (int i = b * BFP_BLOCK_SIZE; i < (b + 1) * BFP_BLOCK_SIZE; i++) {
+                peak = std::max<float>(peak, std::max<float>(fabsf(signal[i].re), fabsf(signal[i].im)));
+                finite &= std::isfinite(decoded[i].re) && std::isfinite(decoded[i].im);
+                maxErr = std::max<float>(maxErr, std::max<float>(fabsf(decoded[i].re - signal[i].re), fabsf(decoded[i].im - signal[i].im)));
+            }
+
+            // Half a step of at most 2 * peak / qmax, weak blocks may also be sent as silent
+            float allowed = (levels[b] < 1e-20f) ? peak : (peak / qmax) * 1.01f;
+            if (!finite || maxErr > allowed) {
+                fprintf(stderr, "%s: block %d (level %g) decoded with an error of %g, allowed %g\n", typeName.c_str(), b, levels[b], maxErr, allowed);
+                ok = false;
+            }
+        }
+    }
+
+    dsp::buffer::free(encoded);
+    dsp::buffer::free(decoded);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    CommandArgsParser args;
+    args.define('h', "help", "Show help");
+    args.define('l', "list", "List the benchmarks without running them");
+    args.define('f', "filter", "Only run the blocks whose name contains this string", "");
+    args.define('d', "duration", "Time spent measuring each case in milliseconds", 200);
+    args.define('b', "buffer", "Only use this buffer size instead of the whole matrix, 0 for all", 0);
+    args.define('o', "output", "Write the JSON report to this file instead of stdout", "");
+    args.define('c', "codec", "Measure the bitrate and SNR of the IQ sample types instead of benchmarking");
+    if (args.parse(argc, argv) < 0) { return -1; }
+    if (args["help"]) {
+        args.showHelp();
+        return 0;
+    }
+
+    std::string filter = args["filter"];
+    int durationMs = args["duration"];
+    int onlyBuffer = args["buffer"];
+    std::string outPath = args["output"];
+
+    pool.init();
+
+    std::vector<BenchCase> cases;
+    addFilterCases(cases);
+    addMultirateCases(cases);
+    addDemodCases(cases);
+    addLoopCases(cases);
+    addCompressionCases(cases);
+
+    std::vector<int> sizes = onlyBuffer ? std::vector<int>{ onlyBuffer } : bufferSizes;
+
+    json report;
+    report["version"] = VERSION_STR;
+    report["duration_ms"] = durationMs;
+#ifdef DSP_BENCH_HAS_TSC
+    report["cycle_counter"] = "tsc";
+#else
+    report["cycle_counter"] = nullptr;
+#endif
+    report["results"] = json::array();
+    if (args["codec"]) {
+        // Only the codec tables were asked for
+        report["codecs"] = measureCodecs(1 << 20, onlyBuffer ? onlyBuffer : 16384);
+        report["codec_round_trip"] = checkCodecRoundTrip();
+        cases.clear();
+    }
+
+    for (const auto& bc : cases) {
+        if (bc.block.find(filter) == std::string::npos) { continue; }
+        for (int bufferSize : sizes) {
+            if (args["list"]) {
+                printf("%s %s buffer=%d\n", bc.block.c_str(), bc.params.dump().c_str(), bufferSize);
+                continue;
+            }
+
+            // Progress goes to stderr to keep stdout clean for the report
+            fprintf(stderr, "%s %s buffer=%d... ", bc.block.c_str(), bc.params.dump().c_str(), bufferSize);
+            dsp::bench::Result res = bc.run(bufferSize, durationMs);
+            fprintf(stderr, "%.2lf MS/s\n", res.msps);
+
+            json r;
+            r["block"] = bc.block;
+            r["params"] = bc.params;
+            r["buffer_size"] = bufferSize;
+            r["samples"] = res.samples;
+            r["seconds"] = res.seconds;
+            r["msps"] = res.msps;
+            r["ns_per_sample"] = res.nsPerSample;
+            r["cycles_per_sample"] = (res.cyclesPerSample >= 0.0) ? json(res.cyclesPerSample) : json(nullptr);
+            r["allocations"] = res.allocations;
+            report["results"].push_back(r);
+        }
+    }
+    if (args["list"]) { return 0; }
+
+    if (outPath.empty()) {
+        printf("%s\n", report.dump(4).c_str());
+    }
+    else {
+        std::ofstream file(outPath);
+        if (!file.is_open()) {
+            fprintf(stderr, "Could not open '%s' for writing\n", outPath.c_str());
+            return -1;
+        }
+        file << report.dump(4);
+    }
+
+    // A failed round trip is an error so that scripts running --codec notice it
+    if (args["codec"] && !report["codec_round_trip"]) { return -1; }
+    return 0;
+}